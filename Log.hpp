@@ -7,8 +7,14 @@
 #include <sys/types.h>
 #include <ctime>
 #include <stdarg.h>
-#include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <fcntl.h>
+#include <sys/uio.h>
 #include <pthread.h>
 
 namespace log_es
@@ -24,8 +30,14 @@ namespace log_es
         FATAL      // 严重错误信息
     };
 
+// 编译期的最低日志级别（取上面枚举对应的数字），低于它的 LOG 调用在编译时就被去掉，
+// 例如 -DVOD_LOG_MIN_LEVEL=3 只保留 WARNING 及以上的日志
+#ifndef VOD_LOG_MIN_LEVEL
+#define VOD_LOG_MIN_LEVEL 1
+#endif
+
     // 将日志级别枚举值转换为字符串
-    std::string LevelToString(int level) // NOLINT
+    const char *LevelToString(int level) // NOLINT
     {
         switch (level)
         {
@@ -44,144 +56,626 @@ namespace log_es
         }
     }
 
-    // 获取当前时间的字符串表示
-    std::string GetCurrTime() // NOLINT
+// 日志时间的后缀：不加后缀、加微秒、加单调时钟读数（秒.微秒，不受系统调时影响）
+#define LOG_TIME_PLAIN 0
+#define LOG_TIME_USEC 1
+#define LOG_TIME_MONO 2
+#ifndef VOD_LOG_TIME_SUFFIX
+#define VOD_LOG_TIME_SUFFIX LOG_TIME_PLAIN
+#endif
+
+    // 把当前时间格式化到 buffer 中，返回长度
+    // 日期和时分秒部分每个线程按秒缓存，同一秒内的日志不再做时区转换
+    size_t FormatCurrTime(char *buffer, size_t size) // NOLINT
     {
-        time_t now = time(nullptr);
-        struct tm *curr_time = localtime(&now);
-        char buffer[128];
-        snprintf(buffer, sizeof(buffer), "%d-%02d-%02d %02d:%02d:%02d",
-                 curr_time->tm_year + 1900, // 年份
-                 curr_time->tm_mon + 1,     // 月份
-                 curr_time->tm_mday,        // 日
-                 curr_time->tm_hour,        // 小时
-                 curr_time->tm_min,         // 分钟
-                 curr_time->tm_sec);        // 秒
-        return buffer;
+        static thread_local time_t cached_sec = -1;
+        static thread_local char cached[64];
+        static thread_local int cached_len = 0;
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec != cached_sec)
+        {
+            struct tm curr_time;
+            localtime_r(&now.tv_sec, &curr_time);
+            cached_len = snprintf(cached, sizeof(cached), "%d-%02d-%02d %02d:%02d:%02d",
+                                  curr_time.tm_year + 1900, // 年份
+                                  curr_time.tm_mon + 1,     // 月份
+                                  curr_time.tm_mday,        // 日
+                                  curr_time.tm_hour,        // 小时
+                                  curr_time.tm_min,         // 分钟
+                                  curr_time.tm_sec);        // 秒
+            cached_sec = now.tv_sec;
+        }
+        int n = cached_len < (int)size ? cached_len : (int)size - 1;
+        memcpy(buffer, cached, n);
+        buffer[n] = '\0';
+#if VOD_LOG_TIME_SUFFIX == LOG_TIME_USEC
+        n += snprintf(buffer + n, size > (size_t)n ? size - n : 0, ".%06ld", (long)(now.tv_nsec / 1000));
+#elif VOD_LOG_TIME_SUFFIX == LOG_TIME_MONO
+        struct timespec mono;
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        n += snprintf(buffer + n, size > (size_t)n ? size - n : 0, " +%ld.%06ld",
+                      (long)mono.tv_sec, (long)(mono.tv_nsec / 1000));
+#endif
+        return (size_t)n < size ? n : size - 1;
     }
 
-    // 日志消息类，用于存储日志的各个部分
-    class LogMessage
+    // 获取当前时间的字符串表示
+    std::string GetCurrTime() // NOLINT
     {
-    public:
-        std::string _level;        // 日志级别
-        pid_t _id;                 // 进程ID
-        std::string _filename;     // 文件名
-        int _filenumber;           // 文件行号
-        std::string _curr_time;    // 当前时间
-        std::string _message_info; // 日志信息
-    };
+        char buffer[64];
+        size_t n = FormatCurrTime(buffer, sizeof(buffer));
+        return std::string(buffer, n);
+    }
 
 // 日志输出类型：屏幕或文件
 #define SCREEN_TYPE 1
 #define FILE_TYPE 2
+// 每个线程的日志缓冲区能放下的日志条数，必须是 2 的幂，每个线程占用 LOG_RING_SLOTS * LOG_LINE_SIZE 字节
+#define LOG_RING_SLOTS 128
+// 一条日志最长的字节数，超出的部分被截断
+#define LOG_LINE_SIZE 1024
+// 后台线程一次 writev 最多写出的日志条数
+#define LOG_BATCH 64
+// 后台线程没有日志可写时的休眠时间（毫秒），休眠之后仍然没有日志就一直休眠到有新日志
+#define LOG_FLUSH_MS 10
 
     const std::string glogfile = "./log.txt";          // 默认日志文件路径
-    pthread_mutex_t glock = PTHREAD_MUTEX_INITIALIZER; // NOLINT  // 全局锁，用于线程安全
+    pthread_mutex_t glock = PTHREAD_MUTEX_INITIALIZER; // NOLINT  // 全局锁，保护输出文件
+
+    // 单生产者单消费者的环形缓冲区：每个写日志的线程独占一个，只由后台线程取出
+    class LogRing
+    {
+    public:
+        // 一条格式化好的日志
+        struct Slot
+        {
+            size_t len;
+            char data[LOG_LINE_SIZE];
+        };
+
+        LogRing() : closed(false), _head(0), _tail(0), _dropped(0), _slots(new Slot[LOG_RING_SLOTS])
+        {
+        }
+
+        // 生产者：取得下一个可写的槽位，缓冲区满时丢弃这条日志并返回 NULL
+        Slot *Reserve()
+        {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) >= LOG_RING_SLOTS)
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            return &_slots[tail & (LOG_RING_SLOTS - 1)];
+        }
+
+        // 生产者：提交 Reserve 取得的槽位，之后后台线程才能看到它
+        void Commit()
+        {
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // 消费者：可以取出的日志条数
+        size_t Readable() const
+        {
+            return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_relaxed);
+        }
+
+        // 消费者：第 i 条可以取出的日志
+        const Slot &At(size_t i) const
+        {
+            return _slots[(_head.load(std::memory_order_relaxed) + i) & (LOG_RING_SLOTS - 1)];
+        }
+
+        // 消费者：前 n 条日志已经写出，槽位还给生产者
+        void Consume(size_t n)
+        {
+            _head.store(_head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+
+        // 取出并清零丢弃的日志条数
+        size_t TakeDropped()
+        {
+            return _dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        // 清空缓冲区，fork 之后子进程丢弃从父进程继承的内容
+        void Reset()
+        {
+            _head.store(_tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> closed; // 所属线程已经退出，取空之后可以释放
 
-    // 日志类，负责日志的输出
+    private:
+        std::atomic<size_t> _head;     // 下一条要取出的位置，只由后台线程修改
+        std::atomic<size_t> _tail;     // 下一条要写入的位置，只由所属线程修改
+        std::atomic<size_t> _dropped;  // 缓冲区满时丢弃的日志条数
+        std::unique_ptr<Slot[]> _slots; // 槽位数组
+    };
+
+    // 线程退出时标记它的缓冲区，由后台线程写完剩下的日志后释放
+    struct LogRingHolder
+    {
+        std::shared_ptr<LogRing> ring;
+        ~LogRingHolder()
+        {
+            if (ring)
+            {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    // 日志类：调用者把日志格式化到自己线程的缓冲区就返回，
+    // 一个后台线程把所有缓冲区里的日志批量 writev 到一直打开着的文件描述符
     class Log
     {
     public:
         // 构造函数，默认日志输出到屏幕
-        Log(const std::string &logfile = glogfile) : _logfile(logfile), _type(SCREEN_TYPE)
+        Log(const std::string &logfile = glogfile)
+            : _logfile(logfile), _type(SCREEN_TYPE), _fd(STDOUT_FILENO), _level(DEBUG), _state(IDLE), _stop(false), _sleeping(false), _pid(getpid())
         {
+            InitWake();
+            pthread_mutex_init(&_rings_mutex, NULL);
         }
 
-        // 设置日志输出类型（屏幕或文件）
+        // 设置日志输出类型（屏幕或文件），日志文件只在这里打开一次
         void Enable(int type)
         {
+            LockGuard lockguard(&glock);
+            int fd = STDOUT_FILENO;
+            if (type == FILE_TYPE)
+            {
+                fd = open(_logfile.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                if (fd < 0)
+                {
+                    return; // 打不开日志文件时保持原来的输出
+                }
+            }
+            if (_fd != STDOUT_FILENO)
+            {
+                close(_fd);
+            }
+            _fd = fd;
             _type = type;
         }
 
-        // 将日志输出到屏幕
-        void FlushLogToScreen(const LogMessage &lg)
+        // 设置运行时的最低日志级别，低于它的日志不格式化也不输出
+        void SetLevel(int level)
+        {
+            _level.store(level, std::memory_order_relaxed);
+        }
+
+        // 判断某个级别的日志是否需要输出，LOG 宏在格式化之前先调用它
+        bool Enabled(int level) const
+        {
+            return level >= _level.load(std::memory_order_relaxed);
+        }
+
+        // 记录日志消息，只格式化到当前线程的缓冲区，不做任何 IO
+        void logMessage(const char *filename, int filenumber, int level, const char *format, ...)
+        {
+            int state = _state.load(std::memory_order_acquire);
+            if (state == IDLE)
+            {
+                Start();
+                state = _state.load(std::memory_order_acquire);
+            }
+            LogRing::Slot direct;
+            LogRing *ring = NULL;
+            LogRing::Slot *slot = &direct;
+            if (state == RUNNING)
+            {
+                ring = LocalRing();
+                slot = ring->Reserve();
+                if (slot == NULL)
+                {
+                    return; // 缓冲区满了，丢弃这条日志，后台线程会报告丢弃的条数
+                }
+            }
+
+            va_list ap;
+            va_start(ap, format);
+            slot->len = Format(slot->data, filename, filenumber, level, format, ap);
+            va_end(ap);
+
+            if (ring != NULL)
+            {
+                ring->Commit();
+                // 缓冲区过半时提前唤醒后台线程，不等它休眠结束
+                if (ring->Readable() >= LOG_RING_SLOTS / 2)
+                {
+                    pthread_cond_signal(&_wake);
+                }
+                // 后台线程因为没有日志而休眠时，由第一条新日志唤醒它
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (_sleeping.load(std::memory_order_relaxed))
+                {
+                    WakeWriter();
+                }
+                return;
+            }
+            // 后台线程已经停止（进程正在退出），直接写出
+            struct iovec iov = {slot->data, slot->len};
+            LockGuard lockguard(&glock);
+            WriteAll(&iov, 1);
+        }
+
+        ~Log()
+        {
+            Stop();
+        }
+
+    private:
+        enum
+        {
+            IDLE,    // 后台线程还没有启动
+            RUNNING, // 后台线程正在运行
+            STOPPED  // 后台线程已经停止，日志直接写出
+        };
+
+        // 格式化一条日志，返回长度
+        size_t Format(char *buf, const char *filename, int filenumber, int level, const char *format, va_list ap)
+        {
+            char curr_time[64];
+            FormatCurrTime(curr_time, sizeof(curr_time));
+            int n = snprintf(buf, LOG_LINE_SIZE, "[%s][%d][%s][%d][%s] ",
+                             LevelToString(level),         // 日志级别
+                             (int)_pid,                    // 进程ID
+                             filename,                     // 文件名
+                             filenumber,                   // 文件行号
+                             curr_time);                   // 当前时间
+            if (n < 0)
+            {
+                n = 0;
+            }
+            if (n < LOG_LINE_SIZE)
+            {
+                int m = vsnprintf(buf + n, LOG_LINE_SIZE - n, format, ap); // 格式化日志信息
+                if (m > 0)
+                {
+                    n += m;
+                }
+            }
+            return n < LOG_LINE_SIZE ? n : LOG_LINE_SIZE - 1;
+        }
+
+        // 初始化后台线程休眠用的锁和条件变量，等待超时使用单调时钟
+        void InitWake()
+        {
+            pthread_condattr_t attr;
+            pthread_condattr_init(&attr);
+            pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+            pthread_cond_init(&_wake, &attr);
+            pthread_condattr_destroy(&attr);
+            pthread_mutex_init(&_wake_mutex, NULL);
+        }
+
+        // 当前线程的缓冲区持有者
+        static LogRingHolder &LocalHolder()
         {
-            printf("[%s][%d][%s][%d][%s] %s",
-                   lg._level.c_str(),         // 日志级别
-                   lg._id,                    // 进程ID
-                   lg._filename.c_str(),      // 文件名
-                   lg._filenumber,            // 文件行号
-                   lg._curr_time.c_str(),     // 当前时间
-                   lg._message_info.c_str()); // 日志信息
+            static thread_local LogRingHolder holder;
+            return holder;
         }
 
-        // 将日志输出到文件
-        void FlushLogToFile(const LogMessage &lg)
+        // 当前线程的缓冲区，第一次使用时创建并登记到新缓冲区列表；
+        // 登记用单独的锁，不会等待正在 writev 的后台线程
+        LogRing *LocalRing()
         {
-            std::ofstream out(_logfile, std::ios::app); // 以追加模式打开日志文件
-            if (!out.is_open())
+            LogRingHolder &holder = LocalHolder();
+            if (!holder.ring)
+            {
+                holder.ring = std::make_shared<LogRing>();
+                LockGuard lockguard(&_rings_mutex);
+                _new_rings.push_back(holder.ring);
+            }
+            return holder.ring.get();
+        }
+
+        // 把新登记的缓冲区移到后台线程自己的列表中
+        void AdoptRings()
+        {
+            LockGuard lockguard(&_rings_mutex);
+            _rings.insert(_rings.end(), _new_rings.begin(), _new_rings.end());
+            _new_rings.clear();
+        }
+
+        // 唤醒因为没有日志而休眠的后台线程，只有一个调用者真正发出信号
+        void WakeWriter()
+        {
+            if (_sleeping.exchange(false))
+            {
+                pthread_mutex_lock(&_wake_mutex);
+                pthread_cond_signal(&_wake);
+                pthread_mutex_unlock(&_wake_mutex);
+            }
+        }
+
+        // 后台线程：是否还有没写出的日志
+        bool Pending()
+        {
+            AdoptRings();
+            for (auto &ring : _rings)
+            {
+                if (ring->Readable() > 0 || ring->closed.load(std::memory_order_acquire))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 启动后台线程，只有第一次记录日志（或 fork 之后第一次）时调用
+        void Start()
+        {
+            LockGuard lockguard(&glock);
+            if (_state.load(std::memory_order_relaxed) != IDLE)
+            {
                 return;
+            }
+            static bool atfork = false;
+            if (atfork == false)
+            {
+                _self = this;
+                pthread_atfork(BeforeFork, AfterForkParent, AfterForkChild);
+                atfork = true;
+            }
+            _pid = getpid();
+            _stop.store(false);
+            if (pthread_create(&_writer, NULL, WriterRoutine, this) != 0)
+            {
+                _state.store(STOPPED, std::memory_order_release);
+                return;
+            }
+            _state.store(RUNNING, std::memory_order_release);
+        }
 
-            char logtxt[2048];
-            snprintf(logtxt, sizeof(logtxt), "[%s][%d][%s][%d][%s] %s",
-                     lg._level.c_str(),         // 日志级别
-                     lg._id,                    // 进程ID
-                     lg._filename.c_str(),      // 文件名
-                     lg._filenumber,            // 文件行号
-                     lg._curr_time.c_str(),     // 当前时间
-                     lg._message_info.c_str()); // 日志信息
-            out.write(logtxt, strlen(logtxt));  // 写入日志信息
-            out.close();                        // 关闭文件
+        // 停止后台线程，写完所有缓冲区中剩下的日志
+        void Stop()
+        {
+            if (_state.load(std::memory_order_acquire) != RUNNING)
+            {
+                return;
+            }
+            _stop.store(true);
+            WakeWriter();
+            pthread_join(_writer, NULL);
+            _state.store(STOPPED, std::memory_order_release);
+            // 后台线程退出之后才写入的日志由这里补写
+            AdoptRings();
+            LockGuard lockguard(&glock);
+            for (auto &ring : _rings)
+            {
+                DrainLocked(ring.get());
+            }
         }
 
-        // 根据日志输出类型，将日志输出到屏幕或文件
-        void FlushLog(const LogMessage &lg)
+        // 把 iov 全部写到输出文件，处理被信号打断和只写了一部分的情况，调用者持有 glock
+        void WriteAll(struct iovec *iov, int cnt)
         {
-            // 以后可以加过滤--TODO
+            while (cnt > 0)
+            {
+                ssize_t n = writev(_fd, iov, cnt);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return;
+                }
+                while (cnt > 0 && (size_t)n >= iov->iov_len)
+                {
+                    n -= iov->iov_len;
+                    iov++;
+                    cnt--;
+                }
+                if (cnt > 0)
+                {
+                    iov->iov_base = (char *)iov->iov_base + n;
+                    iov->iov_len -= n;
+                }
+            }
+        }
 
-            LockGuard lockguard(&glock); // 加锁，确保线程安全
-            switch (_type)
+        // 取出一个缓冲区中的全部日志写出，返回写出的条数，调用者持有 glock
+        size_t DrainLocked(LogRing *ring)
+        {
+            size_t total = 0;
+            size_t dropped = ring->TakeDropped();
+            if (dropped > 0)
+            {
+                char buf[512];
+                int n = snprintf(buf, sizeof(buf), "[%s][%d][%s][%d][%s] %zu log messages dropped\n",
+                                 LevelToString(WARNING), (int)_pid, __FILE__, __LINE__,
+                                 GetCurrTime().c_str(), dropped);
+                struct iovec iov = {buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1};
+                WriteAll(&iov, 1);
+            }
+            while (true)
             {
-            case SCREEN_TYPE:
-                FlushLogToScreen(lg); // 输出到屏幕
-                break;
-            case FILE_TYPE:
-                FlushLogToFile(lg); // 输出到文件
-                break;
-            default:
-                break;
+                size_t cnt = ring->Readable();
+                if (cnt == 0)
+                {
+                    break;
+                }
+                if (cnt > LOG_BATCH)
+                {
+                    cnt = LOG_BATCH;
+                }
+                struct iovec iov[LOG_BATCH];
+                for (size_t i = 0; i < cnt; i++)
+                {
+                    iov[i].iov_base = (void *)ring->At(i).data;
+                    iov[i].iov_len = ring->At(i).len;
+                }
+                WriteAll(iov, (int)cnt);
+                ring->Consume(cnt);
+                total += cnt;
             }
+            return total;
         }
 
-        // 记录日志消息
-        void logMessage(std::string filename, int filenumber, int level, const char *format, ...)
+        // 后台线程：轮流取空每个线程的缓冲区，没有日志时休眠 LOG_FLUSH_MS 凑下一批；
+        // 休眠之后还是没有日志就不设超时一直休眠，由生产者或 Stop 唤醒
+        static void *WriterRoutine(void *arg)
         {
-            LogMessage lg;
-            lg._level = LevelToString(level); // 设置日志级别
-            lg._id = getpid();                // 获取当前进程ID
-            lg._filename = filename;          // 设置文件名
-            lg._filenumber = filenumber;      // 设置文件行号
-            lg._curr_time = GetCurrTime();    // 获取当前时间
+            Log *self = (Log *)arg;
+            bool idle = false;
+            while (true)
+            {
+                bool stop = self->_stop.load(std::memory_order_acquire);
+                size_t total = 0;
+                self->AdoptRings();
+                {
+                    LockGuard lockguard(&glock);
+                    for (auto it = self->_rings.begin(); it != self->_rings.end();)
+                    {
+                        // 先判断线程是否已经退出，再取空缓冲区，避免漏掉退出前写入的日志
+                        bool closed = (*it)->closed.load(std::memory_order_acquire);
+                        total += self->DrainLocked(it->get());
+                        if (closed)
+                        {
+                            it = self->_rings.erase(it);
+                        }
+                        else
+                        {
+                            ++it;
+                        }
+                    }
+                }
+                if (total > 0)
+                {
+                    idle = false;
+                    continue;
+                }
+                if (stop)
+                {
+                    break;
+                }
+                if (idle == false)
+                {
+                    idle = true;
+                    struct timespec ts;
+                    clock_gettime(CLOCK_MONOTONIC, &ts);
+                    ts.tv_nsec += LOG_FLUSH_MS * 1000000L;
+                    if (ts.tv_nsec >= 1000000000L)
+                    {
+                        ts.tv_sec++;
+                        ts.tv_nsec -= 1000000000L;
+                    }
+                    pthread_mutex_lock(&self->_wake_mutex);
+                    pthread_cond_timedwait(&self->_wake, &self->_wake_mutex, &ts);
+                    pthread_mutex_unlock(&self->_wake_mutex);
+                    continue;
+                }
+                // 先声明要休眠再检查一遍，和生产者提交日志之后检查 _sleeping 配对，不会漏掉唤醒
+                pthread_mutex_lock(&self->_wake_mutex);
+                self->_sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (self->_stop.load() || self->Pending())
+                {
+                    self->_sleeping.store(false);
+                }
+                while (self->_sleeping.load())
+                {
+                    pthread_cond_wait(&self->_wake, &self->_wake_mutex);
+                }
+                pthread_mutex_unlock(&self->_wake_mutex);
+                idle = false;
+            }
+            return NULL;
+        }
 
-            va_list ap;
-            va_start(ap, format);
-            char log_info[1024];
-            vsnprintf(log_info, sizeof(log_info), format, ap); // 格式化日志信息
-            va_end(ap);
-            lg._message_info = log_info; // 设置日志信息
+        // fork 之前拿住所有的锁，保证子进程中缓冲区列表和输出文件处于一致的状态
+        static void BeforeFork()
+        {
+            // 后台线程持有 _wake_mutex 时会再拿 _rings_mutex，这里按同样的顺序加锁
+            pthread_mutex_lock(&glock);
+            pthread_mutex_lock(&_self->_wake_mutex);
+            pthread_mutex_lock(&_self->_rings_mutex);
+        }
 
-            // 将日志打印出来
-            FlushLog(lg);
+        static void AfterForkParent()
+        {
+            pthread_mutex_unlock(&_self->_rings_mutex);
+            pthread_mutex_unlock(&_self->_wake_mutex);
+            pthread_mutex_unlock(&glock);
         }
 
-        ~Log()
+        // 子进程中只剩 fork 的那个线程：丢弃继承来的日志，下次记录日志时重新启动后台线程
+        static void AfterForkChild()
         {
+            pthread_mutex_init(&glock, NULL);
+            Log *self = _self;
+            // 条件变量里可能还记着父进程中后台线程的等待状态，重新初始化
+            self->InitWake();
+            pthread_mutex_init(&self->_rings_mutex, NULL);
+            self->_sleeping.store(false);
+            for (auto &ring : self->_rings)
+            {
+                ring->Reset();
+            }
+            for (auto &ring : self->_new_rings)
+            {
+                ring->Reset();
+            }
+            self->_rings.clear();
+            self->_new_rings.clear();
+            if (self->_state.load(std::memory_order_relaxed) == RUNNING)
+            {
+                self->_state.store(IDLE, std::memory_order_relaxed);
+            }
+            self->_pid = getpid();
+            // 当前线程的缓冲区重新登记，其他线程在子进程中已经不存在了
+            LogRingHolder &holder = LocalHolder();
+            if (holder.ring)
+            {
+                self->_rings.push_back(holder.ring);
+            }
         }
 
     private:
-        int _type;            // 日志输出类型（屏幕或文件）
-        std::string _logfile; // 日志文件路径
+        std::string _logfile;                        // 日志文件路径
+        int _type;                                   // 日志输出类型（屏幕或文件）
+        int _fd;                                     // 输出文件描述符，一直保持打开
+        std::atomic<int> _level;                     // 运行时的最低日志级别
+        std::atomic<int> _state;                     // 后台线程的状态
+        std::atomic<bool> _stop;                     // 通知后台线程退出
+        std::atomic<bool> _sleeping;                 // 后台线程没有超时地休眠中，需要生产者唤醒
+        pid_t _pid;                                  // 进程ID，fork 之后更新
+        pthread_t _writer;                           // 后台线程
+        pthread_mutex_t _wake_mutex;                 // 后台线程休眠用的锁
+        pthread_cond_t _wake;                        // 唤醒休眠中的后台线程
+        std::vector<std::shared_ptr<LogRing>> _rings; // 所有线程的缓冲区，只由后台线程使用
+        pthread_mutex_t _rings_mutex;                // 保护新缓冲区列表
+        std::vector<std::shared_ptr<LogRing>> _new_rings; // 新线程登记的缓冲区，等后台线程取走
+        static Log *_self;                           // fork 回调中使用的日志对象
     };
 
+    Log *Log::_self = NULL; // NOLINT
+
     Log lg; // NOLINT  // 全局日志对象
 
 // 宏定义，简化日志记录调用
-#define LOG(Level, Format, ...)                                          \
-    do                                                                   \
-    {                                                                    \
-        lg.logMessage(__FILE__, __LINE__, Level, Format, ##__VA_ARGS__); \
+// 先比较编译期级别（常量，不满足时整条语句被编译器去掉），再比较运行时级别，
+// 两者都通过才会求值参数并格式化日志
+#define LOG(Level, Format, ...)                                              \
+    do                                                                       \
+    {                                                                        \
+        if ((Level) >= VOD_LOG_MIN_LEVEL && lg.Enabled(Level))               \
+        {                                                                    \
+            lg.logMessage(__FILE__, __LINE__, Level, Format, ##__VA_ARGS__); \
+        }                                                                    \
     } while (0)
+#define SetLogLevel(Level)   \
+    do                       \
+    {                        \
+        lg.SetLevel(Level);  \
+    } while (0) // 设置运行时的最低日志级别
 #define EnableScreen()          \
     do                          \
     {                           \
@@ -0,0 +1,433 @@
+#ifndef __MY_CACHE__
+#define __MY_CACHE__
+#include "Data.hpp"
+#include "Search.hpp"
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace log_es;
+
+namespace vod
+{
+    // 序列化好的全部视频信息，生成之后不再修改，多个请求可以同时持有
+    struct Catalog
+    {
+        // 生成这份数据时缓存的版本号
+        uint64_t generation;
+        // 对应的 ETag，带上进程标识，避免重启后版本号重复
+        std::string etag;
+        // 序列化好的 JSON 数据
+        std::string body;
+    };
+
+    // 多个工作进程共用的缓存版本号，放在 fork 之前创建的共享内存中
+    // 任何一个进程修改了数据库就把版本号加一，其他进程读取时发现版本变了就重新加载
+    struct SharedGeneration
+    {
+        // 数据库中数据的版本号
+        std::atomic<uint64_t> value;
+        // 主进程标识，所有工作进程用它生成相同的 ETag
+        char instance[32];
+    };
+
+    // 创建进程间共享的版本号，必须在 fork 工作进程之前调用，失败时返回 NULL
+    static SharedGeneration *CreateSharedGeneration()
+    {
+        void *ptr = mmap(NULL, sizeof(SharedGeneration), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            LOG(ERROR, "CREATE SHARED CACHE GENERATION FAILED!\n");
+            return NULL;
+        }
+        SharedGeneration *shared = new (ptr) SharedGeneration();
+        shared->value.store(1);
+        snprintf(shared->instance, sizeof(shared->instance), "%lx%x",
+                 (unsigned long)time(nullptr), (unsigned int)getpid());
+        return shared;
+    }
+
+    // 视频信息缓存，挡在 TableVideo 前面
+    // 视频数量不多且读多写少，全部记录常驻内存，读请求不再访问数据库；
+    // 写请求先写数据库，成功后在原地更新缓存
+    class VideoCache
+    {
+    private:
+        // 被缓存的视频表
+        TableVideo *_table;
+        // 是否已经从数据库加载过全部记录（可能已经过期）
+        bool _loaded;
+        // 本进程的修改和正在进行的重新加载有冲突，加载完成后还要再加载一次
+        bool _stale;
+        // 是否有线程正在重新加载
+        bool _loading;
+        // 视频 id -> 视频信息，按 id 有序
+        std::map<int, Json::Value> _videos;
+        // 视频名称和简介的倒排索引，搜索不再访问数据库
+        SearchIndex _index;
+        // 缓存的版本号，每次修改都会加一
+        uint64_t _generation;
+        // 进程标识，和版本号一起组成 ETag
+        std::string _instance;
+        // 序列化好的全部视频信息，为空表示需要重新生成
+        std::shared_ptr<const Catalog> _catalog;
+        // 多进程模式下共享的版本号，单进程时为 NULL
+        SharedGeneration *_shared;
+        // 互斥锁，保护上面的缓存数据
+        std::mutex _mutex;
+        // 写锁，保证数据库和缓存按同样的顺序被修改
+        std::mutex _write_mutex;
+        // 重新加载完成时唤醒等待的线程
+        std::condition_variable _load_cond;
+
+    private:
+        // 从数据库查询全部记录并建立索引，不访问缓存的数据，调用时不需要持有 _mutex
+        bool Fetch(std::map<int, Json::Value> *videos, SearchIndex *index)
+        {
+            Json::Value rows;
+            if (_table->SelectAll(&rows) == false)
+            {
+                LOG(ERROR, "LOAD VIDEO CACHE FAILED!\n");
+                return false;
+            }
+            for (Json::ArrayIndex i = 0; i < rows.size(); i++)
+            {
+                int video_id = rows[i]["id"].asInt();
+                (*videos)[video_id] = rows[i];
+                index->Add(video_id, rows[i]["name"].asString(), rows[i]["info"].asString());
+            }
+            return true;
+        }
+
+        // 缓存是否和数据库一致，调用前需要持有 _mutex
+        bool Fresh()
+        {
+            return _loaded && _stale == false &&
+                   (_shared == NULL || _shared->value.load(std::memory_order_acquire) == _generation);
+        }
+
+        // 确保缓存可用，调用前需要持有 _mutex
+        // 需要重新加载时，由一个线程释放 _mutex 查询数据库并建立新的索引，完成后在锁内替换；
+        // 这期间其他读请求继续使用旧的数据，只有还没有任何数据时才等待加载完成
+        bool Ensure(std::unique_lock<std::mutex> &lock)
+        {
+            while (_loading && _loaded == false)
+            {
+                _load_cond.wait(lock);
+            }
+            if (this->Fresh() || _loading)
+            {
+                return true;
+            }
+            // 先读共享版本号再查数据库，查询期间其他进程的修改会让版本号再次变化
+            uint64_t shared = _shared == NULL ? 0 : _shared->value.load(std::memory_order_acquire);
+            _loading = true;
+            _stale = false;
+            lock.unlock();
+            std::map<int, Json::Value> videos;
+            SearchIndex index;
+            bool ok = this->Fetch(&videos, &index);
+            lock.lock();
+            _loading = false;
+            _load_cond.notify_all();
+            if (ok == false)
+            {
+                return false;
+            }
+            // 加载期间又有修改时 Fresh 仍然为 false，下一次读取会再加载一次
+            _videos.swap(videos);
+            std::swap(_index, index);
+            _generation = _shared == NULL ? _generation + 1 : shared;
+            _catalog.reset();
+            _loaded = true;
+            return true;
+        }
+
+        // 数据发生了变化，版本号加一并丢弃旧的序列化结果，调用前需要持有 _mutex
+        void Modified()
+        {
+            _catalog.reset();
+            // 正在重新加载的数据可能不包含这次修改
+            if (_loading)
+            {
+                _stale = true;
+            }
+            if (_shared == NULL)
+            {
+                _generation++;
+                return;
+            }
+            // 通知其他进程；中间如果还有别的进程改过数据，本进程的缓存不完整，下次读取时重新加载
+            uint64_t old = _shared->value.fetch_add(1, std::memory_order_acq_rel);
+            if (old == _generation)
+            {
+                _generation = old + 1;
+            }
+            else
+            {
+                _stale = true;
+            }
+        }
+
+        // 重新生成序列化好的全部视频信息，调用前需要持有 _mutex
+        bool BuildCatalog()
+        {
+            Json::Value videos(Json::arrayValue);
+            for (auto &it : _videos)
+            {
+                videos.append(it.second);
+            }
+            std::shared_ptr<Catalog> catalog = std::make_shared<Catalog>();
+            if (JsonUtil::Serialize(videos, &catalog->body) == false)
+            {
+                return false;
+            }
+            catalog->generation = _generation;
+            catalog->etag = "\"" + _instance + "-" + std::to_string(_generation) + "\"";
+            _catalog = catalog;
+            return true;
+        }
+
+    public:
+        // 构造函数，接收要缓存的视频表
+        VideoCache(TableVideo *table)
+            : _table(table), _loaded(false), _stale(false), _loading(false), _generation(0), _shared(NULL)
+        {
+            // 用启动时间和进程 id 区分不同的进程
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%lx%x", (unsigned long)time(nullptr), (unsigned int)getpid());
+            _instance = buf;
+        }
+
+        // 多进程模式下在 Init 之前调用，和其他工作进程共用版本号和 ETag 前缀
+        void Share(SharedGeneration *shared)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _shared = shared;
+            _instance = shared->instance;
+        }
+
+        // 预先加载全部记录
+        bool Init()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return this->Ensure(lock) && this->BuildCatalog();
+        }
+
+        // 丢弃缓存，下次读取时重新从数据库加载
+        void Invalidate()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _loaded = false;
+            _videos.clear();
+            _index.Clear();
+            this->Modified();
+        }
+
+        // 获取序列化好的全部视频信息
+        bool SelectAll(std::shared_ptr<const Catalog> *catalog)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (this->Ensure(lock) == false)
+            {
+                return false;
+            }
+            if (!_catalog && this->BuildCatalog() == false)
+            {
+                return false;
+            }
+            *catalog = _catalog;
+            return true;
+        }
+
+        // 获取指定 id 的视频信息
+        bool SelectOne(int video_id, Json::Value *video)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (this->Ensure(lock) == false)
+            {
+                return false;
+            }
+            auto it = _videos.find(video_id);
+            if (it == _videos.end())
+            {
+                return false;
+            }
+            *video = it->second;
+            return true;
+        }
+
+        // 确认视频是否还在，给后台任务使用：先等正在进行的重新加载完成，不会用到调用之前就已过期的数据；
+        // 数据库出错时无法确认，当作还在
+        bool Exists(int video_id)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_loading)
+            {
+                _load_cond.wait(lock);
+            }
+            if (this->Ensure(lock) == false)
+            {
+                return true;
+            }
+            return _videos.find(video_id) != _videos.end();
+        }
+
+        // 按主键分页查询：取 id 大于 after_id 的前 limit 条记录，只保留 fields 中的字段
+        // more 带回后面是否还有数据，last_id 带回本页最后一条记录的 id
+        bool SelectPage(int after_id, size_t limit, const std::vector<std::string> &fields,
+                        Json::Value *videos, bool *more, int *last_id)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (this->Ensure(lock) == false)
+            {
+                return false;
+            }
+            *videos = Json::Value(Json::arrayValue);
+            *more = false;
+            *last_id = after_id;
+            // 有序 map 直接定位到游标之后，不需要跳过前面的记录
+            auto it = _videos.upper_bound(after_id);
+            for (; it != _videos.end(); ++it)
+            {
+                if (videos->size() == limit)
+                {
+                    *more = true;
+                    break;
+                }
+                Json::Value video(Json::objectValue);
+                for (auto &field : fields)
+                {
+                    video[field] = it->second[field];
+                }
+                videos->append(video);
+                *last_id = it->first;
+            }
+            return true;
+        }
+
+        // 在名称和简介中搜索关键字，结果按相关度排序
+        bool Search(const std::string &key, Json::Value *videos)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (this->Ensure(lock) == false)
+            {
+                return false;
+            }
+            *videos = Json::Value(Json::arrayValue);
+            // 空关键字和 like '%%' 一样返回全部记录
+            if (key.empty())
+            {
+                for (auto &it : _videos)
+                {
+                    videos->append(it.second);
+                }
+                return true;
+            }
+            // 关键字中没有汉字和字母数字（比如只有标点）时无法使用索引，返回空结果
+            std::vector<int> ids;
+            _index.Search(key, &ids);
+            for (int video_id : ids)
+            {
+                videos->append(_videos[video_id]);
+            }
+            return true;
+        }
+
+        // 新增视频信息，成功后把新记录放入缓存，new_id 不为空时带回新记录的 id
+        bool Insert(const Json::Value &video, int *new_id = NULL)
+        {
+            std::unique_lock<std::mutex> write_lock(_write_mutex);
+            int video_id = 0;
+            if (_table->Insert(video, &video_id) == false)
+            {
+                return false;
+            }
+            if (new_id != NULL)
+            {
+                *new_id = video_id;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_loaded)
+            {
+                Json::Value &record = _videos[video_id];
+                record["id"] = video_id;
+                record["name"] = video["name"].asString();
+                record["info"] = video["info"].asString();
+                record["video"] = video["video"].asString();
+                record["image"] = video["image"].asString();
+                record["hls"] = "";
+                _index.Add(video_id, record["name"].asString(), record["info"].asString());
+            }
+            // 本进程没有缓存这条记录时也要通知其他进程
+            this->Modified();
+            return true;
+        }
+
+        // 修改视频信息，成功后原地更新缓存
+        bool Update(int video_id, const Json::Value &video)
+        {
+            std::unique_lock<std::mutex> write_lock(_write_mutex);
+            if (_table->Update(video_id, video) == false)
+            {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _videos.find(video_id);
+            if (it != _videos.end())
+            {
+                it->second["name"] = video["name"].asString();
+                it->second["info"] = video["info"].asString();
+                _index.Add(video_id, it->second["name"].asString(), it->second["info"].asString());
+            }
+            this->Modified();
+            return true;
+        }
+
+        // 记录视频切片后播放列表的路径，成功后原地更新缓存
+        bool SetHls(int video_id, const std::string &hls)
+        {
+            std::unique_lock<std::mutex> write_lock(_write_mutex);
+            if (_table->SetHls(video_id, hls) == false)
+            {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _videos.find(video_id);
+            if (it != _videos.end())
+            {
+                it->second["hls"] = hls;
+            }
+            this->Modified();
+            return true;
+        }
+
+        // 删除视频信息，成功后从缓存中移除
+        bool Delete(int video_id)
+        {
+            std::unique_lock<std::mutex> write_lock(_write_mutex);
+            if (_table->Delete(video_id) == false)
+            {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_videos.erase(video_id) > 0)
+            {
+                _index.Remove(video_id);
+            }
+            this->Modified();
+            return true;
+        }
+    };
+}
+
+#endif
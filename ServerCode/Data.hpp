@@ -2,8 +2,15 @@
 #define __MY_DATA__
 #include "Util.hpp"
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <mutex>
+#include <map>
+#include <deque>
+#include <chrono>
+#include <condition_variable>
 #include <mariadb/mysql.h>
+#include <mariadb/errmsg.h>
 
 using namespace log_es;
 
@@ -17,6 +24,18 @@ namespace vod
     #define PASS "xxx_pass"
     // 定义要连接的数据库名称
     #define NAME "vod_system"
+    // 定义连接池默认保持的最少连接数
+    #define POOL_MIN_SIZE 2
+    // 定义连接池默认允许的最多连接数
+    #define POOL_MAX_SIZE 16
+    // 定义空闲多久（秒）的连接在取出时需要先做健康检查
+    #define POOL_PING_IDLE_SEC 30
+    // 定义获取连接时最多等待的时间（毫秒）
+    #define POOL_WAIT_MS 3000
+    // 定义读取查询结果时每个字符串字段先用的缓冲区大小，超长的字段再按实际长度读取
+    #define FETCH_BUFSIZ 1024
+    // 定义视频表查询结果的字段数：id, name, info, video, image, hls
+    #define VIDEO_FIELD_COUNT 6
 
     // 初始化 MySQL 连接
     static MYSQL *MysqlInit()
@@ -56,248 +75,568 @@ namespace vod
         return;
     }
 
-    // 执行 MySQL 查询
-    static bool MysqlQuery(MYSQL *mysql, const std::string &sql)
+
+    // 判断 MySQL 错误码是否表示连接已经断开
+    static bool MysqlConnectionLost(unsigned int err)
     {
-        // 执行 SQL 查询
-        int ret = mysql_query(mysql, sql.c_str());
-        // 检查查询是否执行成功
-        if (ret != 0)
+        return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+    }
+
+    // 连接池中的一个连接，以及在这个连接上预处理过的语句
+    // 预处理语句属于创建它的连接，连接重建之后要重新预处理
+    struct MysqlHandle
+    {
+        MYSQL *mysql;
+        // SQL 语句 -> 预处理语句
+        std::map<std::string, MYSQL_STMT *> stmts;
+        // 最近一次归还到连接池的时间
+        time_t last_used;
+    };
+
+    // 关闭连接上所有的预处理语句
+    static void MysqlCloseStmts(MysqlHandle *handle)
+    {
+        for (auto &it : handle->stmts)
         {
-            // 输出执行的 SQL 语句
-            std::cout << sql << std::endl;
-            // 输出 MySQL 错误信息
-            std::cout << mysql_error(mysql) << std::endl;
-            return false;
+            mysql_stmt_close(it.second);
         }
-        return true;
+        handle->stmts.clear();
     }
 
+    // 创建一个连接，连接失败时返回 NULL
+    static MysqlHandle *MysqlHandleInit()
+    {
+        MYSQL *mysql = MysqlInit();
+        if (mysql == NULL)
+        {
+            return NULL;
+        }
+        MysqlHandle *handle = new MysqlHandle();
+        handle->mysql = mysql;
+        handle->last_used = time(nullptr);
+        return handle;
+    }
+
+    // 关闭一个连接和它的预处理语句
+    static void MysqlHandleDestroy(MysqlHandle *handle)
+    {
+        if (handle == NULL)
+        {
+            return;
+        }
+        MysqlCloseStmts(handle);
+        MysqlDestroy(handle->mysql);
+        delete handle;
+    }
+
+    // 重新建立连接，原来的预处理语句全部作废
+    static bool MysqlHandleReconnect(MysqlHandle *handle)
+    {
+        MysqlCloseStmts(handle);
+        MysqlDestroy(handle->mysql);
+        handle->mysql = MysqlInit();
+        return handle->mysql != NULL;
+    }
+
+    // MySQL 连接池，连接数在 [min, max] 之间按需增长
+    class MysqlPool
+    {
+    private:
+        // 空闲连接队列，后归还的放在队尾，优先取出最近用过的连接
+        std::deque<MysqlHandle *> _idle;
+        // 最少连接数
+        size_t _min;
+        // 最多连接数
+        size_t _max;
+        // 当前已经创建的连接总数（包括正在使用的）
+        size_t _total;
+        // 互斥锁，保护空闲队列和连接计数
+        std::mutex _mutex;
+        // 条件变量，连接用满时等待其他线程归还
+        std::condition_variable _cond;
+
+    public:
+        // 构造函数，设置连接池的最少和最多连接数
+        MysqlPool(size_t min = POOL_MIN_SIZE, size_t max = POOL_MAX_SIZE)
+            : _min(min), _max(max < 1 ? 1 : max), _total(0)
+        {
+            if (_min > _max)
+            {
+                _min = _max;
+            }
+            // 多线程使用客户端库之前先完成全局初始化
+            mysql_library_init(0, NULL, NULL);
+        }
+
+        // 析构函数，关闭所有空闲连接
+        ~MysqlPool()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (auto handle : _idle)
+            {
+                MysqlHandleDestroy(handle);
+            }
+            _idle.clear();
+        }
+
+        // 预先创建最少数量的连接，有一个连接失败就返回 false
+        bool Init()
+        {
+            for (size_t i = 0; i < _min; i++)
+            {
+                MysqlHandle *handle = MysqlHandleInit();
+                if (handle == NULL)
+                {
+                    return false;
+                }
+                std::unique_lock<std::mutex> lock(_mutex);
+                _idle.push_back(handle);
+                _total++;
+            }
+            return true;
+        }
+
+        // 取出一个可用的连接，没有可用连接并且等待超时时返回 NULL
+        MysqlHandle *Acquire()
+        {
+            // 整个等待过程共用一个截止时间，被唤醒后没抢到连接也不会重新计时
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(POOL_WAIT_MS);
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true)
+            {
+                // 有空闲连接，直接取出
+                if (_idle.empty() == false)
+                {
+                    MysqlHandle *handle = _idle.back();
+                    _idle.pop_back();
+                    lock.unlock();
+                    // 空闲太久的连接可能已经被服务器断开，先检查一下
+                    if (time(nullptr) - handle->last_used >= POOL_PING_IDLE_SEC &&
+                        mysql_ping(handle->mysql) != 0)
+                    {
+                        LOG(WARNING, "MYSQL CONNECTION IS BROKEN, RECONNECT!\n");
+                        if (MysqlHandleReconnect(handle) == false)
+                        {
+                            this->Release(handle, true);
+                            return NULL;
+                        }
+                    }
+                    return handle;
+                }
+                // 还没有达到最大连接数，创建一个新连接
+                if (_total < _max)
+                {
+                    _total++;
+                    lock.unlock();
+                    MysqlHandle *handle = MysqlHandleInit();
+                    if (handle == NULL)
+                    {
+                        this->Release(NULL, true);
+                    }
+                    return handle;
+                }
+                // 连接已经用满，等待其他线程归还
+                if (_cond.wait_until(lock, deadline) == std::cv_status::timeout &&
+                    _idle.empty() && _total >= _max)
+                {
+                    LOG(ERROR, "WAIT FOR MYSQL CONNECTION TIMEOUT!\n");
+                    return NULL;
+                }
+            }
+        }
+
+        // 归还连接，broken 为 true 表示连接已经不可用，直接关闭
+        void Release(MysqlHandle *handle, bool broken = false)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (broken)
+            {
+                MysqlHandleDestroy(handle);
+                _total--;
+            }
+            else
+            {
+                handle->last_used = time(nullptr);
+                _idle.push_back(handle);
+            }
+            _cond.notify_one();
+        }
+    };
+
+    // 从连接池中借出的一个连接，离开作用域时自动归还
+    class MysqlConn
+    {
+    private:
+        // 所属的连接池
+        MysqlPool *_pool;
+        // 借出的连接
+        MysqlHandle *_handle;
+
+    private:
+        // 取出 SQL 对应的预处理语句，这个连接第一次执行它时才预处理
+        MYSQL_STMT *Prepare(const std::string &sql, unsigned int *err)
+        {
+            auto it = _handle->stmts.find(sql);
+            if (it != _handle->stmts.end())
+            {
+                return it->second;
+            }
+            MYSQL_STMT *stmt = mysql_stmt_init(_handle->mysql);
+            if (stmt == NULL)
+            {
+                LOG(ERROR, "INIT MYSQL STMT FAILED!\n");
+                *err = mysql_errno(_handle->mysql);
+                return NULL;
+            }
+            if (mysql_stmt_prepare(stmt, sql.c_str(), sql.size()) != 0)
+            {
+                // 输出预处理失败的 SQL 语句和错误信息
+                std::cout << sql << std::endl;
+                std::cout << mysql_stmt_error(stmt) << std::endl;
+                *err = mysql_stmt_errno(stmt);
+                mysql_stmt_close(stmt);
+                return NULL;
+            }
+            _handle->stmts[sql] = stmt;
+            return stmt;
+        }
+
+    public:
+        // 构造函数，从连接池中取出一个连接
+        MysqlConn(MysqlPool *pool) : _pool(pool), _handle(pool->Acquire()) {}
+
+        // 析构函数，将连接归还给连接池
+        ~MysqlConn()
+        {
+            if (_handle != NULL)
+            {
+                _pool->Release(_handle);
+            }
+        }
+
+        MysqlConn(const MysqlConn &) = delete;
+        MysqlConn &operator=(const MysqlConn &) = delete;
+
+        // 绑定参数并执行预处理语句，没有参数时 params 为 NULL，失败返回 NULL
+        // 连接已经断开时重连、重新预处理后再执行一次
+        MYSQL_STMT *Execute(const std::string &sql, MYSQL_BIND *params)
+        {
+            if (_handle == NULL)
+            {
+                return NULL;
+            }
+            for (int retry = 0;; retry++)
+            {
+                unsigned int err = 0;
+                MYSQL_STMT *stmt = this->Prepare(sql, &err);
+                if (stmt != NULL)
+                {
+                    if ((params == NULL || mysql_stmt_bind_param(stmt, params) == 0) &&
+                        mysql_stmt_execute(stmt) == 0)
+                    {
+                        return stmt;
+                    }
+                    // 输出执行失败的 SQL 语句和错误信息
+                    std::cout << sql << std::endl;
+                    std::cout << mysql_stmt_error(stmt) << std::endl;
+                    err = mysql_stmt_errno(stmt);
+                }
+                if (retry > 0 || MysqlConnectionLost(err) == false)
+                {
+                    return NULL;
+                }
+                LOG(WARNING, "MYSQL SERVER GONE, RECONNECT!\n");
+                if (MysqlHandleReconnect(_handle) == false)
+                {
+                    // 重连失败，这个连接名额还给连接池
+                    _pool->Release(_handle, true);
+                    _handle = NULL;
+                    return NULL;
+                }
+            }
+        }
+    };
+
     // 视频表操作类
+    // hls 字段保存切片后播放列表的路径，还没有切片完成时为空，已有的表需要先增加这个字段：
+    //   alter table tb_video add column hls varchar(255) default null;
     class TableVideo
     {
     private:
-        // MySQL 连接指针
-        MYSQL *_mysql;
-        // 互斥锁，用于保护多线程访问时的数据安全
-        std::mutex _mutex;
+        // MySQL 连接池，每次操作借出一个连接，多个线程可以同时访问数据库
+        MysqlPool _pool;
+
+    private:
+        // 绑定一个字符串参数，length 必须在语句执行完之前保持有效
+        static void BindString(MYSQL_BIND *bind, const std::string &str, unsigned long *length)
+        {
+            memset(bind, 0, sizeof(MYSQL_BIND));
+            *length = str.size();
+            bind->buffer_type = MYSQL_TYPE_STRING;
+            bind->buffer = (void *)str.data();
+            bind->buffer_length = str.size();
+            bind->length = length;
+        }
+
+        // 绑定一个整数参数
+        static void BindInt(MYSQL_BIND *bind, int *value)
+        {
+            memset(bind, 0, sizeof(MYSQL_BIND));
+            bind->buffer_type = MYSQL_TYPE_LONG;
+            bind->buffer = value;
+        }
+
+        // 读出查询语句的所有结果行，字段顺序为：id, name, info, video, image, hls
+        static bool FetchVideos(MYSQL_STMT *stmt, Json::Value *videos)
+        {
+            // 先把结果全部读到客户端，连接归还之前不会留下没读完的数据
+            if (mysql_stmt_store_result(stmt) != 0)
+            {
+                std::cout << "mysql stmt store result failed!\n";
+                std::cout << mysql_stmt_error(stmt) << std::endl;
+                mysql_stmt_free_result(stmt);
+                return false;
+            }
+            static const char *fields[VIDEO_FIELD_COUNT] = {"id", "name", "info", "video", "image", "hls"};
+            int id = 0;
+            char buf[VIDEO_FIELD_COUNT][FETCH_BUFSIZ];
+            unsigned long length[VIDEO_FIELD_COUNT] = {0};
+            my_bool is_null[VIDEO_FIELD_COUNT] = {0};
+            my_bool error[VIDEO_FIELD_COUNT] = {0};
+            // 为每个字段绑定结果缓冲区
+            MYSQL_BIND result[VIDEO_FIELD_COUNT];
+            memset(result, 0, sizeof(result));
+            for (int i = 0; i < VIDEO_FIELD_COUNT; i++)
+            {
+                result[i].buffer_type = MYSQL_TYPE_STRING;
+                result[i].buffer = buf[i];
+                result[i].buffer_length = FETCH_BUFSIZ;
+                result[i].length = &length[i];
+                result[i].is_null = &is_null[i];
+                result[i].error = &error[i];
+            }
+            result[0].buffer_type = MYSQL_TYPE_LONG;
+            result[0].buffer = &id;
+            result[0].buffer_length = 0;
+            if (mysql_stmt_bind_result(stmt, result) != 0)
+            {
+                std::cout << "mysql stmt bind result failed!\n";
+                mysql_stmt_free_result(stmt);
+                return false;
+            }
+            bool ret = true;
+            while (ret)
+            {
+                int status = mysql_stmt_fetch(stmt);
+                if (status == MYSQL_NO_DATA)
+                {
+                    break;
+                }
+                if (status != 0 && status != MYSQL_DATA_TRUNCATED)
+                {
+                    std::cout << "mysql stmt fetch failed!\n";
+                    std::cout << mysql_stmt_error(stmt) << std::endl;
+                    ret = false;
+                    break;
+                }
+                Json::Value video;
+                video["id"] = id;
+                for (int i = 1; i < VIDEO_FIELD_COUNT && ret; i++)
+                {
+                    if (is_null[i])
+                    {
+                        video[fields[i]] = "";
+                    }
+                    else if (length[i] <= FETCH_BUFSIZ)
+                    {
+                        video[fields[i]] = std::string(buf[i], length[i]);
+                    }
+                    else
+                    {
+                        // 字段比缓冲区长（比如很长的简介），按实际长度重新读取这一列
+                        std::string value(length[i], '\0');
+                        MYSQL_BIND column;
+                        memset(&column, 0, sizeof(column));
+                        column.buffer_type = MYSQL_TYPE_STRING;
+                        column.buffer = &value[0];
+                        column.buffer_length = length[i];
+                        if (mysql_stmt_fetch_column(stmt, &column, i, 0) != 0)
+                        {
+                            std::cout << "mysql stmt fetch column failed!\n";
+                            ret = false;
+                        }
+                        video[fields[i]] = value;
+                    }
+                }
+                if (ret)
+                {
+                    // 将记录添加到 videos 中
+                    videos->append(video);
+                }
+            }
+            // 释放查询结果，语句留在连接上下次继续使用
+            mysql_stmt_free_result(stmt);
+            return ret;
+        }
 
     public:
-        // 构造函数，初始化 MySQL 连接
-        TableVideo()
+        // 构造函数，初始化 MySQL 连接池
+        TableVideo(size_t min = POOL_MIN_SIZE, size_t max = POOL_MAX_SIZE) : _pool(min, max)
         {
-            // 调用 MysqlInit 函数初始化 MySQL 连接
-            _mysql = MysqlInit();
             // 检查 MySQL 连接是否成功
-            if (_mysql == NULL)
+            if (_pool.Init() == false)
             {
                 // 若连接失败，退出程序
                 exit(-1);
             }
         }
 
-        // 析构函数，销毁 MySQL 连接
-        ~TableVideo()
-        {
-            // 调用 MysqlDestroy 函数关闭 MySQL 连接
-            MysqlDestroy(_mysql);
-        }
-
-        // 向视频表中插入一条记录
-        bool Insert(const Json::Value &video)
+        // 向视频表中插入一条记录，video_id 不为空时带回新记录的 id
+        bool Insert(const Json::Value &video, int *video_id = NULL)
         {
             // 视频表的字段：id, name, info, video, image
-            std::string sql;
-            // 调整字符串大小，防止简介过长
-            sql.resize(4096 + video["info"].asString().size());
-            // 定义插入语句的格式化字符串
-            #define INSERT_VIDEO "insert tb_video values(null, '%s', '%s', '%s', '%s');"
+            #define INSERT_VIDEO "insert into tb_video (name, info, video, image) values (?, ?, ?, ?);"
             // 检查视频名称是否为空
             if (video["name"].asString().size() == 0)
             {
                 return false;
             }
-            // 使用 sprintf 函数生成插入语句
-            sprintf(&sql[0], INSERT_VIDEO, video["name"].asCString(),
-                    video["info"].asCString(),
-                    video["video"].asCString(),
-                    video["image"].asCString());
-            // 调用 MysqlQuery 函数执行插入语句
-            return MysqlQuery(_mysql, sql);
+            std::string name = video["name"].asString();
+            std::string info = video["info"].asString();
+            std::string url = video["video"].asString();
+            std::string image = video["image"].asString();
+            // 绑定插入语句的参数，字符串原样发给服务器，不需要转义
+            MYSQL_BIND params[4];
+            unsigned long length[4];
+            BindString(&params[0], name, &length[0]);
+            BindString(&params[1], info, &length[1]);
+            BindString(&params[2], url, &length[2]);
+            BindString(&params[3], image, &length[3]);
+            // 从连接池借出一个连接执行插入语句
+            MysqlConn conn(&_pool);
+            MYSQL_STMT *stmt = conn.Execute(INSERT_VIDEO, params);
+            if (stmt == NULL)
+            {
+                return false;
+            }
+            // 获取自增主键的值
+            if (video_id != NULL)
+            {
+                *video_id = (int)mysql_stmt_insert_id(stmt);
+            }
+            return true;
         }
 
         // 更新视频表中的一条记录
         bool Update(int video_id, const Json::Value &video)
         {
-            std::string sql;
-            // 调整字符串大小，防止简介过长
-            sql.resize(4096 + video["info"].asString().size());
-            // 定义更新语句的格式化字符串
-            #define UPDATE_VIDEO "update tb_video set name='%s', info='%s' where id=%d;"
-            // 使用 sprintf 函数生成更新语句
-            sprintf(&sql[0], UPDATE_VIDEO, video["name"].asCString(),
-                    video["info"].asCString(), video_id);
-            // 调用 MysqlQuery 函数执行更新语句
-            return MysqlQuery(_mysql, sql);
+            #define UPDATE_VIDEO "update tb_video set name=?, info=? where id=?;"
+            std::string name = video["name"].asString();
+            std::string info = video["info"].asString();
+            // 绑定更新语句的参数
+            MYSQL_BIND params[3];
+            unsigned long length[2];
+            BindString(&params[0], name, &length[0]);
+            BindString(&params[1], info, &length[1]);
+            BindInt(&params[2], &video_id);
+            // 从连接池借出一个连接执行更新语句
+            MysqlConn conn(&_pool);
+            return conn.Execute(UPDATE_VIDEO, params) != NULL;
         }
 
         // 删除视频表中的一条记录
         bool Delete(int video_id)
         {
-            // 定义删除语句的格式化字符串
-            #define DELETE_VIDEO "delete from tb_video where id=%d;"
-            char sql[1024] = {0};
-            // 使用 sprintf 函数生成删除语句
-            sprintf(sql, DELETE_VIDEO, video_id);
-            // 调用 MysqlQuery 函数执行删除语句
-            return MysqlQuery(_mysql, sql);
+            #define DELETE_VIDEO "delete from tb_video where id=?;"
+            MYSQL_BIND params[1];
+            BindInt(&params[0], &video_id);
+            // 从连接池借出一个连接执行删除语句
+            MysqlConn conn(&_pool);
+            return conn.Execute(DELETE_VIDEO, params) != NULL;
+        }
+
+        // 记录视频切片后播放列表的路径
+        bool SetHls(int video_id, const std::string &hls)
+        {
+            #define SETHLS_VIDEO "update tb_video set hls=? where id=?;"
+            MYSQL_BIND params[2];
+            unsigned long length[1];
+            BindString(&params[0], hls, &length[0]);
+            BindInt(&params[1], &video_id);
+            // 从连接池借出一个连接执行更新语句
+            MysqlConn conn(&_pool);
+            return conn.Execute(SETHLS_VIDEO, params) != NULL;
         }
 
         // 查询视频表中的所有记录
         bool SelectAll(Json::Value *videos)
         {
-            // 定义查询所有记录的 SQL 语句
-            #define SELECTALL_VIDEO "select * from tb_video;"
-            // 加锁，保护查询与保存结果到本地的过程
-            _mutex.lock(); 
-            // 调用 MysqlQuery 函数执行查询语句
-            bool ret = MysqlQuery(_mysql, SELECTALL_VIDEO);
-            if (ret == false)
+            #define SELECTALL_VIDEO "select id, name, info, video, image, hls from tb_video;"
+            // 从连接池借出一个连接，查询与读取结果都在这个连接上完成
+            MysqlConn conn(&_pool);
+            MYSQL_STMT *stmt = conn.Execute(SELECTALL_VIDEO, NULL);
+            if (stmt == NULL)
             {
-                // 解锁
-                _mutex.unlock();
                 return false;
             }
-            // 存储查询结果
-            MYSQL_RES *res = mysql_store_result(_mysql);
-            if (res == NULL)
-            {
-                std::cout << "mysql store result failed!\n";
-                // 解锁
-                _mutex.unlock();
-                return false;
-            }
-            // 解锁
-            _mutex.unlock(); 
-            // 获取查询结果的行数
-            int num_rows = mysql_num_rows(res);
-            for (int i = 0; i < num_rows; i++)
-            {
-                // 获取一行记录
-                MYSQL_ROW row = mysql_fetch_row(res);
-                Json::Value video;
-                video["id"] = atoi(row[0]);
-                video["name"] = row[1];
-                video["info"] = row[2];
-                video["video"] = row[3];
-                video["image"] = row[4];
-                // 将记录添加到 videos 中
-                videos->append(video);
-            }
-            // 释放查询结果
-            mysql_free_result(res);
-            return true;
+            return FetchVideos(stmt, videos);
         }
 
         // 查询视频表中的一条记录
         bool SelectOne(int video_id, Json::Value *video)
         {
-            // 定义查询一条记录的 SQL 语句
-            #define SELECTONE_VIDEO "select * from tb_video where id=%d;"
-            char sql[1024] = {0};
-            // 使用 sprintf 函数生成查询语句
-            sprintf(sql, SELECTONE_VIDEO, video_id);
-            // 加锁，保护查询与保存结果到本地的过程
-            _mutex.lock(); 
-            // 调用 MysqlQuery 函数执行查询语句
-            bool ret = MysqlQuery(_mysql, sql);
-            if (ret == false)
+            #define SELECTONE_VIDEO "select id, name, info, video, image, hls from tb_video where id=?;"
+            MYSQL_BIND params[1];
+            BindInt(&params[0], &video_id);
+            // 从连接池借出一个连接，查询与读取结果都在这个连接上完成
+            MysqlConn conn(&_pool);
+            MYSQL_STMT *stmt = conn.Execute(SELECTONE_VIDEO, params);
+            if (stmt == NULL)
             {
-                // 解锁
-                _mutex.unlock();
                 return false;
             }
-            // 存储查询结果
-            MYSQL_RES *res = mysql_store_result(_mysql);
-            if (res == NULL)
+            Json::Value videos(Json::arrayValue);
+            if (FetchVideos(stmt, &videos) == false)
             {
-                std::cout << "mysql store result failed!\n";
-                // 解锁
-                _mutex.unlock();
                 return false;
             }
-            // 解锁
-            _mutex.unlock(); 
-            // 获取查询结果的行数
-            int num_rows = mysql_num_rows(res);
-            if (num_rows != 1)
+            if (videos.size() != 1)
             {
                 std::cout << "have no data!\n";
-                // 释放查询结果
-                mysql_free_result(res);
                 return false;
             }
-            // 获取一行记录
-            MYSQL_ROW row = mysql_fetch_row(res);
-            (*video)["id"] = video_id;
-            (*video)["name"] = row[1];
-            (*video)["info"] = row[2];
-            (*video)["video"] = row[3];
-            (*video)["image"] = row[4];
-            // 释放查询结果
-            mysql_free_result(res);
+            *video = videos[0];
             return true;
         }
 
         // 模糊查询视频表中的记录
         bool SelectLike(const std::string &key, Json::Value *videos)
         {
-            // 定义模糊查询的 SQL 语句
-            #define SELECTLIKE_VIDEO "select * from tb_video where name like '%%%s%%';"
-            char sql[1024] = {0};
-            // 使用 sprintf 函数生成查询语句
-            sprintf(sql, SELECTLIKE_VIDEO, key.c_str());
-            // 加锁，保护查询与保存结果到本地的过程
-            _mutex.lock(); 
-            // 调用 MysqlQuery 函数执行查询语句
-            bool ret = MysqlQuery(_mysql, sql);
-            if (ret == false)
+            #define SELECTLIKE_VIDEO "select id, name, info, video, image, hls from tb_video where name like ?;"
+            // 关键字中的通配符按普通字符匹配，前后加上 % 表示包含关键字
+            std::string pattern = "%";
+            for (auto c : key)
             {
-                // 解锁
-                _mutex.unlock();
-                return false;
+                if (c == '%' || c == '_' || c == '\\')
+                {
+                    pattern += '\\';
+                }
+                pattern += c;
             }
-            // 存储查询结果
-            MYSQL_RES *res = mysql_store_result(_mysql);
-            if (res == NULL)
+            pattern += "%";
+            MYSQL_BIND params[1];
+            unsigned long length[1];
+            BindString(&params[0], pattern, &length[0]);
+            // 从连接池借出一个连接，查询与读取结果都在这个连接上完成
+            MysqlConn conn(&_pool);
+            MYSQL_STMT *stmt = conn.Execute(SELECTLIKE_VIDEO, params);
+            if (stmt == NULL)
             {
-                std::cout << "mysql store result failed!\n";
-                // 解锁
-                _mutex.unlock();
                 return false;
             }
-            // 解锁
-            _mutex.unlock(); 
-            // 获取查询结果的行数
-            int num_rows = mysql_num_rows(res);
-            for (int i = 0; i < num_rows; i++)
-            {
-                // 获取一行记录
-                MYSQL_ROW row = mysql_fetch_row(res);
-                Json::Value video;
-                video["id"] = atoi(row[0]);
-                video["name"] = row[1];
-                video["info"] = row[2];
-                video["video"] = row[3];
-                video["image"] = row[4];
-                // 将记录添加到 videos 中
-                videos->append(video);
-            }
-            // 释放查询结果
-            mysql_free_result(res);
-            return true;
+            return FetchVideos(stmt, videos);
         }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,498 @@
+#ifndef __MY_HLS__
+#define __MY_HLS__
+#include "Cache.hpp"
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+extern char **environ;
+
+using namespace log_es;
+
+namespace vod
+{
+    // 定义切片使用的 ffmpeg 程序，在 PATH 中查找
+    #define HLS_FFMPEG "ffmpeg"
+    // 定义每个切片的目标时长（秒），切片只能从关键帧开始，实际时长会有出入
+    #define HLS_SEGMENT_SEC "6"
+    // 定义切片格式：mpegts 兼容性最好；fmp4 是 fMP4 切片，可以和 DASH 共用
+    #define HLS_SEGMENT_TYPE "mpegts"
+    // 定义播放列表的文件名
+    #define HLS_PLAYLIST "index.m3u8"
+    // 定义 ffmpeg 进程的 nice 值，切片让着处理请求的线程
+    #define HLS_NICE 10
+    // 定义 ffmpeg 出错时最多把多少字节的错误输出写进日志
+    #define HLS_ERROR_LOG_MAX 1024
+    // 定义启动时补切片每次从缓存中取多少条视频信息
+    #define HLS_BACKFILL_PAGE 100
+    // 定义等待 ffmpeg 退出时的轮询间隔（毫秒）
+    #define HLS_POLL_MS 200
+    // 定义锁文件被其他进程占用时，任务推迟多久再试（毫秒）
+    #define HLS_RETRY_MS 1000
+    // 定义切片期间多久确认一次视频还没有被删除（毫秒）
+    #define HLS_CHECK_MS 1000
+
+    // 视频切片流水线
+    // 上传完成后，后台线程调用 ffmpeg 把原始视频切成 HLS 切片和播放列表，放在 ./www/video/<id>/ 下，
+    // 完成后把播放列表的路径记录到视频表中；能直接转封装就不重新编码，转封装失败时再转码成 H.264/AAC
+    // 每个视频有一个锁文件，放在静态资源目录之外的工作目录中，切片和删除切片目录的进程都要先拿到它；
+    // 锁被其他进程占用时任务推迟一会儿再试，先处理队列中后面的任务
+    class HlsPipeline
+    {
+    private:
+        // 一个任务：切片，或者删除视频后清理切片目录
+        struct Job
+        {
+            int video_id;
+            // 原始视频文件的路径，为空表示清理切片目录
+            std::string source;
+            // 锁文件被其他进程占用时，推迟到这个时间再试
+            std::chrono::steady_clock::time_point retry_at;
+        };
+        // 视频信息缓存，切片完成后通过它写数据库
+        VideoCache *_cache;
+        // 静态资源根目录
+        std::string _root;
+        // 视频目录相对静态资源根目录的路径
+        std::string _video_root;
+        // 存放锁文件和 ffmpeg 错误输出的工作目录
+        std::string _work_root;
+        // 等待切片的任务
+        std::deque<Job> _jobs;
+        // 正在切片的视频 id 和 ffmpeg 进程 id，没有时为 0
+        int _running_id;
+        pid_t _running_pid;
+        // 是否要停止后台线程
+        bool _stop;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        // 执行切片的后台线程
+        std::thread _thread;
+
+    private:
+        // 启动 ffmpeg 并等待它退出，标准错误写入 errlog，成功时返回 true
+        bool Spawn(int video_id, const std::vector<std::string> &args, const std::string &errlog)
+        {
+            std::vector<char *> argv;
+            for (auto &arg : args)
+            {
+                argv.push_back((char *)arg.c_str());
+            }
+            argv.push_back(NULL);
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+            posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+            posix_spawn_file_actions_addopen(&actions, 2, errlog.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            // 工作进程屏蔽了退出信号，ffmpeg 要恢复默认的信号掩码和处理方式，才能被 Cancel 终止
+            posix_spawnattr_t attr;
+            posix_spawnattr_init(&attr);
+            sigset_t mask, defaults;
+            sigemptyset(&mask);
+            sigemptyset(&defaults);
+            sigaddset(&defaults, SIGTERM);
+            sigaddset(&defaults, SIGINT);
+            sigaddset(&defaults, SIGPIPE);
+            posix_spawnattr_setsigmask(&attr, &mask);
+            posix_spawnattr_setsigdefault(&attr, &defaults);
+            posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+            pid_t pid = 0;
+            int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attr);
+            if (err != 0)
+            {
+                LOG(ERROR, "START %s FAILED: %s\n", argv[0], strerror(err));
+                return false;
+            }
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _running_pid = pid;
+                // 启动期间被取消或者要求停止
+                if (_stop || _running_id == 0)
+                {
+                    kill(pid, SIGTERM);
+                }
+            }
+            // 视频可能被其他工作进程删除，那边的 Cancel 管不到这里，等待期间定期确认视频还在
+            int status = 0;
+            int waited = 0;
+            bool killed = false;
+            while (true)
+            {
+                pid_t ret = waitpid(pid, &status, WNOHANG);
+                if (ret == pid || (ret < 0 && errno != EINTR))
+                {
+                    break;
+                }
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cond.wait_for(lock, std::chrono::milliseconds(HLS_POLL_MS));
+                }
+                waited += HLS_POLL_MS;
+                if (killed == false && waited % HLS_CHECK_MS == 0 && this->Exists(video_id) == false)
+                {
+                    LOG(INFO, "VIDEO %d DELETED, STOP SEGMENTING\n", video_id);
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _running_id = 0;
+                    }
+                    kill(pid, SIGTERM);
+                    killed = true;
+                }
+            }
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _running_pid = 0;
+            }
+            return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+
+        // 把 ffmpeg 的错误输出写进日志，然后删除
+        static void ReportError(int video_id, const std::string &errlog)
+        {
+            std::string err;
+            FileUtil(errlog).GetContent(&err);
+            if (err.size() > HLS_ERROR_LOG_MAX)
+            {
+                err.resize(HLS_ERROR_LOG_MAX);
+            }
+            LOG(ERROR, "HLS SEGMENT VIDEO %d FAILED: %s\n", video_id, err.c_str());
+        }
+
+        // 视频是否还在视频表中，不使用过期的缓存，其他进程刚删除的视频也能发现
+        bool Exists(int video_id)
+        {
+            return _cache->Exists(video_id);
+        }
+
+        // 打开视频的锁文件并加锁，不等待；其他进程占用时 busy 带回 true
+        int Lock(int video_id, bool *busy)
+        {
+            *busy = false;
+            std::string lock_name = _work_root + std::to_string(video_id) + ".lock";
+            int lock_fd = open(lock_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+            if (lock_fd < 0)
+            {
+                LOG(ERROR, "OPEN HLS LOCK FAILED: %s\n", lock_name.c_str());
+                return -1;
+            }
+            if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0)
+            {
+                *busy = errno == EWOULDBLOCK;
+                close(lock_fd);
+                return -1;
+            }
+            return lock_fd;
+        }
+
+        // 切片一个视频，锁文件被其他进程占用时返回 false，由调用者推迟再试
+        bool Process(const Job &job)
+        {
+            std::string id = std::to_string(job.video_id);
+            std::string dir = _root + _video_root + id;
+            // 已经删除的视频直接放弃，不要重新创建清理时删掉的锁文件
+            if (this->Exists(job.video_id) == false)
+            {
+                return true;
+            }
+            // 多个工作进程启动时会补切同样的视频，热重启时旧进程也可能还没切完，用文件锁保证只有一个进程在切
+            bool busy = false;
+            int lock_fd = this->Lock(job.video_id, &busy);
+            if (lock_fd < 0)
+            {
+                return busy == false;
+            }
+            // 拿到锁以后重新确认：视频可能已经被删除，也可能已经被其他进程切完并记录过了
+            Json::Value video;
+            if (this->Exists(job.video_id) == false ||
+                (_cache->SelectOne(job.video_id, &video) && video["hls"].asString().empty() == false))
+            {
+                close(lock_fd);
+                return true;
+            }
+            std::string playlist = dir + "/" + HLS_PLAYLIST;
+            // 切片输出到临时播放列表，全部完成后再改名，不会有人读到写了一半的列表
+            std::string temp = dir + "/.index.m3u8";
+            std::string errlog = _work_root + id + ".log";
+            // 播放列表已经存在说明上次切完了，只是没来得及记录
+            bool ok = access(playlist.c_str(), F_OK) == 0;
+            if (ok == false)
+            {
+                // 清掉上次切到一半留下的切片
+                FileUtil(dir).RemoveDirectory();
+                FileUtil(dir).CreateDirectory();
+                std::string ext = strcmp(HLS_SEGMENT_TYPE, "fmp4") == 0 ? ".m4s" : ".ts";
+                std::vector<std::string> output = {
+                    "-f", "hls",
+                    "-hls_time", HLS_SEGMENT_SEC,
+                    "-hls_playlist_type", "vod",
+                    "-hls_segment_type", HLS_SEGMENT_TYPE,
+                    "-hls_segment_filename", dir + "/seg%05d" + ext,
+                    temp};
+                // 先尝试只转封装，不重新编码
+                std::vector<std::string> remux = {HLS_FFMPEG, "-nostdin", "-y", "-loglevel", "error",
+                                                  "-i", job.source, "-c", "copy"};
+                remux.insert(remux.end(), output.begin(), output.end());
+                ok = this->Spawn(job.video_id, remux, errlog);
+                if (ok == false && this->Cancelled() == false)
+                {
+                    // 转封装中途失败时已经写出了一部分切片，转码前清空，转码的切片更少时不会留下多余的
+                    FileUtil(dir).RemoveDirectory();
+                    FileUtil(dir).CreateDirectory();
+                    // 编码格式 HLS 不支持时转码成 H.264/AAC，按切片时长插入关键帧
+                    std::vector<std::string> transcode = {HLS_FFMPEG, "-nostdin", "-y", "-loglevel", "error",
+                                                          "-i", job.source,
+                                                          "-c:v", "libx264", "-preset", "veryfast", "-crf", "23",
+                                                          "-force_key_frames", "expr:gte(t,n_forced*" HLS_SEGMENT_SEC ")",
+                                                          "-c:a", "aac", "-b:a", "128k"};
+                    transcode.insert(transcode.end(), output.begin(), output.end());
+                    ok = this->Spawn(job.video_id, transcode, errlog);
+                }
+                if (ok)
+                {
+                    ok = rename(temp.c_str(), playlist.c_str()) == 0;
+                }
+                else if (this->Cancelled() == false)
+                {
+                    ReportError(job.video_id, errlog);
+                }
+                unlink(errlog.c_str());
+            }
+            unlink(temp.c_str());
+            if (this->Exists(job.video_id) == false)
+            {
+                // 切片期间视频被删除了，清理切片目录的任务可能已经执行过，这里持有锁，由这里删除
+                FileUtil(dir).RemoveDirectory();
+            }
+            else if (ok && this->Cancelled() == false)
+            {
+                if (_cache->SetHls(job.video_id, _video_root + id + "/" + HLS_PLAYLIST))
+                {
+                    LOG(INFO, "HLS SEGMENT VIDEO %d DONE\n", job.video_id);
+                }
+            }
+            // 锁文件保留下来，以后删除视频时还要用它
+            close(lock_fd);
+            return true;
+        }
+
+        // 视频被删除后清理切片目录和锁文件，锁文件被其他进程占用时返回 false，由调用者推迟再试
+        bool Clean(int video_id)
+        {
+            std::string id = std::to_string(video_id);
+            bool busy = false;
+            int lock_fd = this->Lock(video_id, &busy);
+            if (lock_fd < 0 && busy)
+            {
+                return false;
+            }
+            FileUtil(_root + _video_root + id).RemoveDirectory();
+            if (lock_fd >= 0)
+            {
+                // 视频已经从数据库中删除，以后拿到这个锁的进程（包括已经打开了旧锁文件的进程）
+                // 都会在确认视频是否存在时放弃，不会再写这个目录；删掉锁文件，免得工作目录中越积越多
+                unlink((_work_root + id + ".lock").c_str());
+                close(lock_fd);
+            }
+            return true;
+        }
+
+        // 正在切片的视频是否已经被取消
+        bool Cancelled()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _stop || _running_id == 0;
+        }
+
+        // 后台线程：依次处理队列中的任务，跳过还没到重试时间的任务
+        void Run()
+        {
+            // Linux 上 nice 值属于线程，降低本线程的优先级，ffmpeg 启动时就继承它，它创建的线程也一样
+            setpriority(PRIO_PROCESS, syscall(SYS_gettid), HLS_NICE);
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    while (true)
+                    {
+                        if (_stop)
+                        {
+                            lock.unlock();
+                            this->Drain();
+                            return;
+                        }
+                        auto now = std::chrono::steady_clock::now();
+                        auto next = _jobs.end();
+                        for (auto it = _jobs.begin(); it != _jobs.end(); ++it)
+                        {
+                            if (next == _jobs.end() || it->retry_at < next->retry_at)
+                            {
+                                next = it;
+                            }
+                            if (it->retry_at <= now)
+                            {
+                                next = it;
+                                break;
+                            }
+                        }
+                        if (next == _jobs.end())
+                        {
+                            _cond.wait(lock);
+                        }
+                        else if (next->retry_at > now)
+                        {
+                            _cond.wait_until(lock, next->retry_at);
+                        }
+                        else
+                        {
+                            job = *next;
+                            _jobs.erase(next);
+                            break;
+                        }
+                    }
+                    _running_id = job.video_id;
+                }
+                bool done = job.source.empty() ? this->Clean(job.video_id) : this->Process(job);
+                std::unique_lock<std::mutex> lock(_mutex);
+                // 没有被取消的任务拿不到锁时放回队列，过一会儿再试
+                if (done == false && (job.source.empty() || _running_id == job.video_id))
+                {
+                    job.retry_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(HLS_RETRY_MS);
+                    _jobs.push_back(job);
+                }
+                _running_id = 0;
+            }
+        }
+
+        // 停止前把还没清理的切片目录再试一次，拿不到锁的留给占用它的进程处理
+        void Drain()
+        {
+            std::vector<int> ids;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                for (auto &job : _jobs)
+                {
+                    if (job.source.empty())
+                    {
+                        ids.push_back(job.video_id);
+                    }
+                }
+            }
+            for (int video_id : ids)
+            {
+                this->Clean(video_id);
+            }
+        }
+
+    public:
+        // 构造函数，接收视频信息缓存、静态资源根目录、视频目录和工作目录
+        HlsPipeline(VideoCache *cache, const std::string &root, const std::string &video_root,
+                    const std::string &work_root)
+            : _cache(cache), _root(root), _video_root(video_root), _work_root(work_root),
+              _running_id(0), _running_pid(0), _stop(false)
+        {
+        }
+
+        ~HlsPipeline()
+        {
+            this->Stop();
+        }
+
+        // 启动后台线程，并把还没有切片的视频加入队列（上次切到一半进程就退出了，或者是升级前上传的视频）
+        void Start()
+        {
+            FileUtil(_work_root).CreateDirectory();
+            _thread = std::thread([this]() { this->Run(); });
+            int after_id = 0;
+            bool more = true;
+            while (more)
+            {
+                Json::Value videos;
+                if (_cache->SelectPage(after_id, HLS_BACKFILL_PAGE, {"id", "video", "hls"}, &videos, &more, &after_id) == false)
+                {
+                    return;
+                }
+                for (Json::ArrayIndex i = 0; i < videos.size(); i++)
+                {
+                    std::string source = _root + videos[i]["video"].asString();
+                    if (videos[i]["hls"].asString().empty() && access(source.c_str(), R_OK) == 0)
+                    {
+                        this->Submit(videos[i]["id"].asInt(), source);
+                    }
+                }
+            }
+        }
+
+        // 停止后台线程，正在运行的 ffmpeg 会被终止，下次启动时重新切片
+        void Stop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+                if (_running_pid != 0)
+                {
+                    kill(_running_pid, SIGTERM);
+                }
+            }
+            _cond.notify_all();
+            if (_thread.joinable())
+            {
+                _thread.join();
+            }
+        }
+
+        // 把一个视频加入切片队列
+        void Submit(int video_id, const std::string &source)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _jobs.push_back({video_id, source, std::chrono::steady_clock::time_point()});
+            }
+            _cond.notify_one();
+        }
+
+        // 取消一个视频的切片，正在运行的 ffmpeg 会被终止，不等它退出
+        void Cancel(int video_id)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (auto it = _jobs.begin(); it != _jobs.end();)
+            {
+                it = it->video_id == video_id && it->source.empty() == false ? _jobs.erase(it) : it + 1;
+            }
+            if (_running_id == video_id)
+            {
+                _running_id = 0;
+                if (_running_pid != 0)
+                {
+                    kill(_running_pid, SIGTERM);
+                }
+            }
+        }
+
+        // 视频被删除时调用：取消切片，由后台线程清理切片目录，不阻塞调用者
+        // 调用前视频信息已经从数据库中删除，其他工作进程中正在切这个视频的 ffmpeg 会在确认视频是否存在时停下来
+        void Remove(int video_id)
+        {
+            this->Cancel(video_id);
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _jobs.push_front({video_id, "", std::chrono::steady_clock::time_point()});
+            }
+            _cond.notify_one();
+        }
+    };
+}
+
+#endif
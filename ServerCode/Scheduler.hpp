@@ -0,0 +1,486 @@
+#ifndef __MY_SCHEDULER__
+#define __MY_SCHEDULER__
+#include "httplib.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+
+namespace vod
+{
+    // 定义每个工作线程本地任务队列的容量，必须是 2 的幂，放满后任务进入收件箱
+    #define SCHED_DEQUE_SIZE 4096
+    // 定义线程刚执行完任务或者被叫醒时，睡眠前尝试窃取任务的轮数；
+    // 等待超时醒来时只检查一轮，空闲的线程不会每次醒来都空转
+    #define SCHED_STEAL_ROUNDS 64
+    // 定义空闲线程每次睡眠的最长时间（毫秒），醒来后再检查一遍其他线程的任务
+    #define SCHED_IDLE_WAIT_MS 100
+
+    // 队列中的一个任务
+    typedef std::function<void()> Task;
+
+    // Chase-Lev 工作窃取双端队列：所属线程在底部压入和弹出（后进先出），
+    // 其他线程从顶部窃取（先进先出），只有队列中剩最后一个任务时才需要 CAS
+    class WorkDeque
+    {
+    private:
+        // 顶部，窃取者从这里取任务
+        std::atomic<int64_t> _top;
+        // 底部，只由所属线程修改
+        std::atomic<int64_t> _bottom;
+        // 环形数组
+        std::unique_ptr<std::atomic<Task *>[]> _buffer;
+
+    public:
+        WorkDeque() : _top(0), _bottom(0), _buffer(new std::atomic<Task *>[SCHED_DEQUE_SIZE])
+        {
+            for (int i = 0; i < SCHED_DEQUE_SIZE; i++)
+            {
+                _buffer[i].store(NULL, std::memory_order_relaxed);
+            }
+        }
+
+        // 所属线程压入一个任务，队列已满时返回 false
+        bool Push(Task *task)
+        {
+            int64_t b = _bottom.load(std::memory_order_relaxed);
+            int64_t t = _top.load(std::memory_order_acquire);
+            if (b - t >= SCHED_DEQUE_SIZE)
+            {
+                return false;
+            }
+            _buffer[b & (SCHED_DEQUE_SIZE - 1)].store(task, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // 所属线程弹出最近压入的任务，队列为空时返回 NULL
+        Task *Pop()
+        {
+            int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+            _bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = _top.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                // 队列为空，恢复底部
+                _bottom.store(b + 1, std::memory_order_relaxed);
+                return NULL;
+            }
+            Task *task = _buffer[b & (SCHED_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // 只剩最后一个任务，和窃取者竞争
+                if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed) == false)
+                {
+                    task = NULL;
+                }
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        // 其他线程窃取最早压入的任务，队列为空或者竞争失败时返回 NULL
+        Task *Steal()
+        {
+            int64_t t = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = _bottom.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return NULL;
+            }
+            Task *task = _buffer[t & (SCHED_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+            if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed) == false)
+            {
+                return NULL;
+            }
+            return task;
+        }
+    };
+
+    // 把 "0-3,8,10-11" 格式的 CPU 列表解析成编号数组
+    static std::vector<int> ParseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < list.size())
+        {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+            std::string item = list.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.empty() || isdigit((unsigned char)item[0]) == 0)
+            {
+                continue;
+            }
+            int first = atoi(item.c_str());
+            int last = first;
+            size_t dash = item.find('-');
+            if (dash != std::string::npos)
+            {
+                last = atoi(item.c_str() + dash + 1);
+            }
+            for (int cpu = first; cpu <= last; cpu++)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // 读取 NUMA 拓扑，返回每个 CPU 所在的节点编号；没有 NUMA 信息时所有 CPU 都在节点 0
+    static std::vector<int> ReadCpuNodes(int cpu_count)
+    {
+        std::vector<int> nodes(cpu_count, 0);
+        DIR *dir = opendir("/sys/devices/system/node");
+        if (dir == NULL)
+        {
+            return nodes;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                isdigit((unsigned char)name[4]) == 0)
+            {
+                continue;
+            }
+            int node = atoi(name.c_str() + 4);
+            std::ifstream in("/sys/devices/system/node/" + name + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+            for (int cpu : ParseCpuList(list))
+            {
+                if (cpu >= 0 && cpu < cpu_count)
+                {
+                    nodes[cpu] = node;
+                }
+            }
+        }
+        closedir(dir);
+        return nodes;
+    }
+
+    // 工作窃取线程池，可以替换 httplib 自带的单队列 ThreadPool
+    // 每个工作线程有自己的 Chase-Lev 队列和一个收件箱：外部线程（accept 线程、IO 线程）
+    // 提交的任务轮流放进各个线程的收件箱，工作线程提交的任务直接压入自己的队列；
+    // 线程空闲时先窃取同一 NUMA 节点上其他线程的任务，再窃取其他节点的
+    class WorkStealingPool : public httplib::TaskQueue
+    {
+    private:
+        // 每个工作线程的状态
+        struct Worker
+        {
+            // 本地任务队列
+            WorkDeque deque;
+            // 收件箱，保存其他线程提交给它的任务
+            std::deque<Task *> inbox;
+            // 保护收件箱和睡眠状态
+            std::mutex mutex;
+            // 睡眠用的条件变量
+            std::condition_variable cond;
+            // 是否正在睡眠
+            bool sleeping;
+            // 绑定的 CPU，-1 表示不绑定
+            int cpu;
+            // 所在的 NUMA 节点
+            int node;
+            // 窃取顺序：先同一节点，再其他节点
+            std::vector<size_t> victims;
+            std::thread thread;
+
+            Worker() : sleeping(false), cpu(-1), node(0) {}
+        };
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        // 外部提交任务时轮流选择工作线程
+        std::atomic<size_t> _next;
+        // 正在睡眠的线程数
+        std::atomic<size_t> _sleepers;
+        // 还没有执行完的任务数，关闭线程池时用来判断是否已经取空
+        std::atomic<size_t> _pending;
+        std::atomic<bool> _shutdown;
+
+        // 当前线程所属的线程池和编号，不是工作线程时为 NULL
+        static WorkStealingPool *&CurrentPool()
+        {
+            static thread_local WorkStealingPool *pool = NULL;
+            return pool;
+        }
+        static size_t &CurrentIndex()
+        {
+            static thread_local size_t index = 0;
+            return index;
+        }
+
+    public:
+        // 创建 n 个工作线程，pin 为 true 时把线程按 NUMA 节点依次绑定到允许使用的 CPU 上；
+        // 线程数超过允许使用的 CPU 数时不绑定，否则几个线程挤在一个 CPU 上，内核也不能把它们挪到空闲的 CPU
+        WorkStealingPool(size_t n, bool pin = false)
+            : _next(0), _sleepers(0), _pending(0), _shutdown(false)
+        {
+            if (n == 0)
+            {
+                n = 1;
+            }
+            // 只使用进程允许使用的 CPU（容器或 taskset 可能做了限制），按节点排序
+            std::vector<int> cpus;
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                {
+                    if (CPU_ISSET(cpu, &allowed))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+            std::vector<int> nodes = ReadCpuNodes(cpus.empty() ? 0 : cpus.back() + 1);
+            std::stable_sort(cpus.begin(), cpus.end(), [&](int a, int b)
+                             { return nodes[a] < nodes[b]; });
+            if (n > cpus.size())
+            {
+                pin = false;
+            }
+
+            for (size_t i = 0; i < n; i++)
+            {
+                std::unique_ptr<Worker> worker(new Worker());
+                if (cpus.empty() == false)
+                {
+                    int cpu = cpus[i % cpus.size()];
+                    worker->node = nodes[cpu];
+                    worker->cpu = pin ? cpu : -1;
+                }
+                _workers.push_back(std::move(worker));
+            }
+            // 窃取顺序：从自己的下一个线程开始，同一节点的排在前面
+            for (size_t i = 0; i < n; i++)
+            {
+                for (size_t k = 1; k < n; k++)
+                {
+                    _workers[i]->victims.push_back((i + k) % n);
+                }
+                std::stable_sort(_workers[i]->victims.begin(), _workers[i]->victims.end(),
+                                 [&](size_t a, size_t b)
+                                 {
+                                     return (_workers[a]->node != _workers[i]->node) <
+                                            (_workers[b]->node != _workers[i]->node);
+                                 });
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                _workers[i]->thread = std::thread([this, i]()
+                                                  { this->Run(i); });
+            }
+        }
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        ~WorkStealingPool() override
+        {
+            this->shutdown();
+        }
+
+        // 提交一个任务
+        void enqueue(std::function<void()> fn) override
+        {
+            Task *task = new Task(std::move(fn));
+            _pending.fetch_add(1, std::memory_order_relaxed);
+            // 工作线程自己提交的任务直接压入本地队列
+            if (CurrentPool() == this && _workers[CurrentIndex()]->deque.Push(task))
+            {
+                this->WakeIdle();
+                return;
+            }
+            size_t i = _next.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+            Worker &worker = *_workers[i];
+            bool sleeping;
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.inbox.push_back(task);
+                sleeping = worker.sleeping;
+            }
+            if (sleeping)
+            {
+                worker.cond.notify_one();
+            }
+            else
+            {
+                // 目标线程正忙，叫醒一个空闲线程来窃取
+                this->WakeIdle();
+            }
+        }
+
+        // 执行完所有已经提交的任务后停止全部工作线程
+        void shutdown() override
+        {
+            if (_shutdown.exchange(true))
+            {
+                return;
+            }
+            for (auto &worker : _workers)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(worker->mutex);
+                }
+                worker->cond.notify_all();
+            }
+            for (auto &worker : _workers)
+            {
+                if (worker->thread.joinable())
+                {
+                    worker->thread.join();
+                }
+            }
+        }
+
+    private:
+        // 有线程在睡眠时叫醒其中一个
+        void WakeIdle()
+        {
+            if (_sleepers.load(std::memory_order_acquire) == 0)
+            {
+                return;
+            }
+            for (auto &worker : _workers)
+            {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                if (worker->sleeping)
+                {
+                    worker->sleeping = false;
+                    lock.unlock();
+                    worker->cond.notify_one();
+                    return;
+                }
+            }
+        }
+
+        // 把收件箱中的任务搬到本地队列，本地队列放不下时留在收件箱
+        void DrainInbox(Worker &self)
+        {
+            std::unique_lock<std::mutex> lock(self.mutex);
+            while (self.inbox.empty() == false && self.deque.Push(self.inbox.front()))
+            {
+                self.inbox.pop_front();
+            }
+        }
+
+        // 从其他线程窃取一个任务：先窃取队列，再从收件箱中拿
+        Task *StealFrom(Worker &self)
+        {
+            for (size_t victim : self.victims)
+            {
+                Task *task = _workers[victim]->deque.Steal();
+                if (task != NULL)
+                {
+                    return task;
+                }
+            }
+            for (size_t victim : self.victims)
+            {
+                Worker &other = *_workers[victim];
+                std::unique_lock<std::mutex> lock(other.mutex, std::try_to_lock);
+                if (lock.owns_lock() && other.inbox.empty() == false)
+                {
+                    Task *task = other.inbox.front();
+                    other.inbox.pop_front();
+                    return task;
+                }
+            }
+            return NULL;
+        }
+
+        // 取得下一个要执行的任务，没有任务时返回 NULL
+        Task *Next(Worker &self)
+        {
+            this->DrainInbox(self);
+            Task *task = self.deque.Pop();
+            if (task != NULL)
+            {
+                return task;
+            }
+            return this->StealFrom(self);
+        }
+
+        // 工作线程主循环
+        void Run(size_t index)
+        {
+            Worker &self = *_workers[index];
+            CurrentPool() = this;
+            CurrentIndex() = index;
+            if (self.cpu >= 0)
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(self.cpu, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+            int rounds = SCHED_STEAL_ROUNDS;
+            while (true)
+            {
+                Task *task = NULL;
+                for (int round = 0; round < rounds && task == NULL; round++)
+                {
+                    task = this->Next(self);
+                    if (task == NULL)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                if (task != NULL)
+                {
+                    (*task)();
+                    delete task;
+                    _pending.fetch_sub(1, std::memory_order_release);
+                    rounds = SCHED_STEAL_ROUNDS;
+                    continue;
+                }
+                if (_shutdown.load(std::memory_order_acquire) &&
+                    _pending.load(std::memory_order_acquire) == 0)
+                {
+                    break;
+                }
+                // 没有任务可做，睡眠到有任务提交给自己或者被叫醒去窃取
+                // 关闭时其他线程的任务还没执行完，也在这里等，不空转
+                std::unique_lock<std::mutex> lock(self.mutex);
+                if (self.inbox.empty())
+                {
+                    self.sleeping = true;
+                    _sleepers.fetch_add(1, std::memory_order_release);
+                    self.cond.wait_for(lock, std::chrono::milliseconds(SCHED_IDLE_WAIT_MS));
+                    // WakeIdle 叫醒时会清掉 sleeping，说明有任务可以窃取；否则是超时，只检查一轮
+                    rounds = self.sleeping ? 1 : SCHED_STEAL_ROUNDS;
+                    self.sleeping = false;
+                    _sleepers.fetch_sub(1, std::memory_order_release);
+                }
+            }
+        }
+    };
+}
+
+#endif
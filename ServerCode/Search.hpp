@@ -0,0 +1,378 @@
+#ifndef __MY_SEARCH__
+#define __MY_SEARCH__
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+namespace vod
+{
+    // 定义字母数字单词最多按多长建索引，更长的单词和查询词都截断到这个长度
+    #define SEARCH_WORD_MAX 64
+    // 定义视频名称中命中的权重，简介中命中的权重为 1
+    #define SEARCH_NAME_WEIGHT 3
+
+    // 视频名称和简介的倒排索引
+    // 中日韩文字没有空格分词，连续的汉字按单字和相邻两字（bigram）建索引；
+    // 字母数字按单词建索引，另外记录所有单词的后缀，查询词可以是单词中间的任意一段，和 like '%key%' 一样
+    class SearchIndex
+    {
+    private:
+        // 一个词在一条记录中出现的次数
+        struct Hits
+        {
+            int name;
+            int info;
+        };
+        // 词 -> (视频 id -> 出现次数)
+        std::unordered_map<std::string, std::unordered_map<int, Hits>> _postings;
+        // 视频 id -> 这条记录建立过索引的词，删除记录时使用
+        std::unordered_map<int, std::vector<std::string>> _terms;
+        // (后缀, 单词)：所有出现过的字母数字单词的每个后缀，按后缀排序；
+        // 查询词是某个后缀的前缀，就是这个单词的一部分。只和词表大小有关，和记录数无关
+        std::set<std::pair<std::string, std::string>> _suffixes;
+
+    private:
+        // 判断码点是否是中日韩文字
+        static bool IsCJK(uint32_t c)
+        {
+            return (c >= 0x4E00 && c <= 0x9FFF) ||   // 中日韩统一表意文字
+                   (c >= 0x3400 && c <= 0x4DBF) ||   // 扩展 A
+                   (c >= 0x20000 && c <= 0x2A6DF) || // 扩展 B
+                   (c >= 0xF900 && c <= 0xFAFF) ||   // 兼容表意文字
+                   (c >= 0x3040 && c <= 0x30FF) ||   // 平假名、片假名
+                   (c >= 0xAC00 && c <= 0xD7AF);     // 韩文音节
+        }
+
+        // 解码一个 UTF-8 字符，返回码点，pos 移动到下一个字符，非法字节按单字节处理
+        static uint32_t NextCodePoint(const std::string &text, size_t *pos)
+        {
+            unsigned char c = text[*pos];
+            size_t len = 1;
+            uint32_t cp = c;
+            if (c >= 0xF0 && c <= 0xF7)
+            {
+                len = 4;
+                cp = c & 0x07;
+            }
+            else if (c >= 0xE0)
+            {
+                len = 3;
+                cp = c & 0x0F;
+            }
+            else if (c >= 0xC0)
+            {
+                len = 2;
+                cp = c & 0x1F;
+            }
+            if (len > 1)
+            {
+                if (*pos + len > text.size())
+                {
+                    (*pos)++;
+                    return c;
+                }
+                for (size_t i = 1; i < len; i++)
+                {
+                    unsigned char cc = text[*pos + i];
+                    if ((cc & 0xC0) != 0x80)
+                    {
+                        (*pos)++;
+                        return c;
+                    }
+                    cp = (cp << 6) | (cc & 0x3F);
+                }
+            }
+            *pos += len;
+            return cp;
+        }
+
+        // 把文本切分成连续的中日韩文字片段和字母数字单词，单词统一转成小写
+        template <typename CJKRun, typename Word>
+        static void Split(const std::string &text, CJKRun on_cjk, Word on_word)
+        {
+            std::vector<std::string> cjk;
+            std::string word;
+            size_t pos = 0;
+            while (true)
+            {
+                size_t begin = pos;
+                uint32_t cp = 0;
+                bool end = pos >= text.size();
+                if (end == false)
+                {
+                    cp = NextCodePoint(text, &pos);
+                }
+                bool is_cjk = end == false && IsCJK(cp);
+                bool is_word = end == false && cp < 0x80 && isalnum((int)cp);
+                if (is_cjk == false && cjk.empty() == false)
+                {
+                    on_cjk(cjk);
+                    cjk.clear();
+                }
+                if (is_word == false && word.empty() == false)
+                {
+                    on_word(word);
+                    word.clear();
+                }
+                if (end)
+                {
+                    break;
+                }
+                if (is_cjk)
+                {
+                    cjk.push_back(text.substr(begin, pos - begin));
+                }
+                else if (is_word)
+                {
+                    word.push_back((char)tolower((int)cp));
+                }
+            }
+        }
+
+        // 字母数字单词只由 ASCII 组成，汉字的词都是多字节的
+        static bool IsWord(const std::string &term)
+        {
+            return (unsigned char)term[0] < 0x80;
+        }
+
+        // 生成建立索引用的词：汉字的单字和 bigram，字母数字单词本身
+        static void IndexTerms(const std::string &text, std::vector<std::string> *terms)
+        {
+            Split(text,
+                [&](const std::vector<std::string> &chars)
+                {
+                    for (size_t i = 0; i < chars.size(); i++)
+                    {
+                        terms->push_back(chars[i]);
+                        if (i + 1 < chars.size())
+                        {
+                            terms->push_back(chars[i] + chars[i + 1]);
+                        }
+                    }
+                },
+                [&](const std::string &word)
+                {
+                    terms->push_back(word.substr(0, SEARCH_WORD_MAX));
+                });
+        }
+
+        // 生成查询用的词：汉字片段拆成相邻两字，单字只能按单字查；单词在后缀表中按子串查
+        static void QueryTerms(const std::string &text, std::vector<std::string> *terms)
+        {
+            Split(text,
+                [&](const std::vector<std::string> &chars)
+                {
+                    if (chars.size() == 1)
+                    {
+                        terms->push_back(chars[0]);
+                    }
+                    for (size_t i = 0; i + 1 < chars.size(); i++)
+                    {
+                        terms->push_back(chars[i] + chars[i + 1]);
+                    }
+                },
+                [&](const std::string &word)
+                {
+                    terms->push_back(word.substr(0, SEARCH_WORD_MAX));
+                });
+        }
+
+        // 第一次出现的单词加入后缀表
+        void AddSuffixes(const std::string &word)
+        {
+            for (size_t i = 0; i < word.size(); i++)
+            {
+                _suffixes.insert(std::make_pair(word.substr(i), word));
+            }
+        }
+
+        // 不再出现的单词从后缀表中删除
+        void RemoveSuffixes(const std::string &word)
+        {
+            for (size_t i = 0; i < word.size(); i++)
+            {
+                _suffixes.erase(std::make_pair(word.substr(i), word));
+            }
+        }
+
+        // 找到包含查询词的所有单词，把它们的倒排表合并到 merged 中
+        void MatchWord(const std::string &term, std::unordered_map<int, Hits> *merged) const
+        {
+            std::set<std::string> words;
+            for (auto it = _suffixes.lower_bound(std::make_pair(term, std::string()));
+                 it != _suffixes.end() && it->first.compare(0, term.size(), term) == 0; ++it)
+            {
+                words.insert(it->second);
+            }
+            for (auto &word : words)
+            {
+                auto posting = _postings.find(word);
+                if (posting == _postings.end())
+                {
+                    continue;
+                }
+                for (auto &hit : posting->second)
+                {
+                    Hits &hits = (*merged)[hit.first];
+                    hits.name += hit.second.name;
+                    hits.info += hit.second.info;
+                }
+            }
+        }
+
+    public:
+        // 为一条记录建立索引，已有的索引先删除
+        void Add(int video_id, const std::string &name, const std::string &info)
+        {
+            this->Remove(video_id);
+            std::vector<std::string> name_terms, info_terms;
+            IndexTerms(name, &name_terms);
+            IndexTerms(info, &info_terms);
+            std::vector<std::string> &terms = _terms[video_id];
+            for (auto &term : name_terms)
+            {
+                Hits &hits = _postings[term][video_id];
+                if (hits.name == 0 && hits.info == 0)
+                {
+                    terms.push_back(term);
+                }
+                hits.name++;
+            }
+            for (auto &term : info_terms)
+            {
+                Hits &hits = _postings[term][video_id];
+                if (hits.name == 0 && hits.info == 0)
+                {
+                    terms.push_back(term);
+                }
+                hits.info++;
+            }
+            for (auto &term : terms)
+            {
+                if (IsWord(term) && _postings[term].size() == 1)
+                {
+                    this->AddSuffixes(term);
+                }
+            }
+        }
+
+        // 删除一条记录的索引
+        void Remove(int video_id)
+        {
+            auto it = _terms.find(video_id);
+            if (it == _terms.end())
+            {
+                return;
+            }
+            for (auto &term : it->second)
+            {
+                auto posting = _postings.find(term);
+                if (posting == _postings.end())
+                {
+                    continue;
+                }
+                posting->second.erase(video_id);
+                if (posting->second.empty())
+                {
+                    _postings.erase(posting);
+                    if (IsWord(term))
+                    {
+                        this->RemoveSuffixes(term);
+                    }
+                }
+            }
+            _terms.erase(it);
+        }
+
+        // 清空全部索引
+        void Clear()
+        {
+            _postings.clear();
+            _terms.clear();
+            _suffixes.clear();
+        }
+
+        // 查询同时包含所有查询词的记录，按相关度从高到低返回 id；
+        // 查询中没有可用的词时返回 false，由调用者决定如何处理
+        bool Search(const std::string &key, std::vector<int> *ids) const
+        {
+            ids->clear();
+            std::vector<std::string> terms;
+            QueryTerms(key, &terms);
+            if (terms.empty())
+            {
+                return false;
+            }
+            std::sort(terms.begin(), terms.end());
+            terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+            // 找到每个词的倒排表，任何一个词不存在就没有结果；
+            // 单词是所有包含它的单词的倒排表合并起来的结果
+            std::vector<std::unordered_map<int, Hits>> merged(terms.size());
+            std::vector<const std::unordered_map<int, Hits> *> postings;
+            for (size_t i = 0; i < terms.size(); i++)
+            {
+                if (IsWord(terms[i]))
+                {
+                    this->MatchWord(terms[i], &merged[i]);
+                    if (merged[i].empty())
+                    {
+                        return true;
+                    }
+                    postings.push_back(&merged[i]);
+                    continue;
+                }
+                auto it = _postings.find(terms[i]);
+                if (it == _postings.end())
+                {
+                    return true;
+                }
+                postings.push_back(&it->second);
+            }
+            // 从最短的倒排表开始求交集
+            std::sort(postings.begin(), postings.end(),
+                [](const std::unordered_map<int, Hits> *a, const std::unordered_map<int, Hits> *b)
+                {
+                    return a->size() < b->size();
+                });
+            double total = (double)_terms.size();
+            std::vector<std::pair<double, int>> scored;
+            for (auto &candidate : *postings[0])
+            {
+                int video_id = candidate.first;
+                double score = 0;
+                bool matched = true;
+                for (auto posting : postings)
+                {
+                    auto hit = posting->find(video_id);
+                    if (hit == posting->end())
+                    {
+                        matched = false;
+                        break;
+                    }
+                    // 词频乘以逆文档频率，越少见的词越重要
+                    double idf = log(1.0 + total / posting->size());
+                    score += (SEARCH_NAME_WEIGHT * hit->second.name + hit->second.info) * idf;
+                }
+                if (matched)
+                {
+                    scored.push_back(std::make_pair(-score, video_id));
+                }
+            }
+            // 相关度相同时按 id 排序，保证结果稳定
+            std::sort(scored.begin(), scored.end());
+            for (auto &item : scored)
+            {
+                ids->push_back(item.second);
+            }
+            return true;
+        }
+    };
+}
+
+#endif
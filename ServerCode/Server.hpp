@@ -1,4 +1,7 @@
 #include "Data.hpp"
+#include "Cache.hpp"
+#include "Hls.hpp"
+#include "Scheduler.hpp"
 #include "httplib.h"
 
 namespace vod
@@ -9,9 +12,44 @@ namespace vod
     #define VIDEO_ROOT "/video/"
     // 定义图片文件存储的相对路径
     #define IMAGE_ROOT "/image/"
+    // 定义上传过程中临时文件的目录，放在静态资源根目录之外，没有写完的文件不能被下载；
+    // 提交时用 rename 移动到静态资源目录下，两个目录要在同一个文件系统上
+    #define UPLOAD_TEMP_ROOT "./upload/"
+    // 定义切片时锁文件和 ffmpeg 错误输出的目录，同样放在静态资源根目录之外
+    #define HLS_WORK_ROOT "./hls/"
+    // 定义上传表单中文本字段的最大长度
+    #define UPLOAD_FIELD_MAX (1024 * 1024)
+    // 定义分页查询默认每页的记录数
+    #define PAGE_DEFAULT_LIMIT 20
+    // 定义分页查询每页最多的记录数
+    #define PAGE_MAX_LIMIT 100
+    // 定义 epoll 事件循环的 IO 线程数，空闲的长连接只由 IO 线程监听，不再占用工作线程；
+    // 设为 0 时回到每个连接占用一个工作线程的模式
+    #define IO_THREAD_COUNT 2
+    // 定义执行请求的工作线程数，处理函数会阻塞在数据库和磁盘上，所以和 httplib 一样至少 8 个
+    #define WORKER_THREAD_COUNT CPPHTTPLIB_THREAD_POOL_COUNT
+    // 定义是否把工作线程按 NUMA 节点绑定到 CPU 上；处理函数会阻塞在数据库和磁盘上，
+    // 默认不绑定，由内核把可以运行的线程调度到空闲的 CPU 上。多进程模式下各工作进程
+    // 会绑定到同样的 CPU 上，所以这时总是不绑定
+    #define WORKER_PIN_CPU false
+    // 定义静态资源最多缓存多少个打开的文件，热门的缩略图和视频不再每次 open 和 stat；
+    // 文件被修改或删除时由 inotify 通知丢弃缓存，设为 0 时关闭缓存
+    #define STATIC_FILE_CACHE_COUNT 256
+    // 定义不超过多少字节的静态资源直接放在内存中，css、js 同时缓存 gzip 和 brotli 压缩后的版本
+    #define STATIC_MEMORY_FILE_SIZE (1024 * 1024)
+    // 定义放在内存中的静态资源最多占用多少字节
+    #define STATIC_MEMORY_TOTAL_SIZE (64 * 1024 * 1024)
+    // 定义静态资源默认的 Cache-Control：浏览器每次都要验证，没有变化时服务器返回 304
+    #define STATIC_CACHE_CONTROL "no-cache"
+    // 定义样式、脚本、字体、图片和视频的 Cache-Control：一天之内直接使用浏览器缓存
+    #define ASSET_CACHE_CONTROL "public, max-age=86400"
 
     // 声明一个指向 TableVideo 类的指针，用于管理视频表的数据库操作
     TableVideo *tb_video = NULL;
+    // 声明一个指向 VideoCache 类的指针，视频信息的读写都经过这层缓存
+    VideoCache *video_cache = NULL;
+    // 全局视频切片流水线指针
+    HlsPipeline *hls_pipeline = NULL;
 
     // 定义 Server 类，用于搭建和运行 HTTP 服务器，处理视频相关的请求
     class Server
@@ -19,18 +57,171 @@ namespace vod
     private:
         // 服务器监听的端口号
         int _port;
+        // 多进程模式下各工作进程共用的缓存版本号，单进程时为 NULL
+        SharedGeneration *_shared;
+        // 绑定端口后通知主进程已经可以接收连接的管道写端，没有时为 -1
+        int _ready_fd;
         // httplib 库的服务器实例，用于处理 HTTP 请求
         httplib::Server _srv;
 
     private:
+        // 把字符串解析为非负整数，格式不对时返回 false
+        static bool ParseNumber(const std::string &str, long *num)
+        {
+            if (str.empty() || str.size() > 9 || str.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return false;
+            }
+            *num = strtol(str.c_str(), NULL, 10);
+            return true;
+        }
+
+        // 处理 GET 请求，按主键分页查询视频信息，可以只返回指定的字段
+        // 参数：after_id 上一页最后一条记录的 id，limit 每页记录数，fields 逗号分隔的字段列表
+        static void SelectPage(const httplib::Request &req, httplib::Response &rsp)
+        {
+            long after_id = 0;
+            long limit = PAGE_DEFAULT_LIMIT;
+            std::vector<std::string> fields;
+            bool valid = true;
+            if (req.has_param("after_id"))
+            {
+                valid = valid && ParseNumber(req.get_param_value("after_id"), &after_id);
+            }
+            if (req.has_param("limit"))
+            {
+                valid = valid && ParseNumber(req.get_param_value("limit"), &limit) && limit > 0;
+            }
+            // 每页的记录数不能超过服务器的上限
+            limit = std::min(limit, (long)PAGE_MAX_LIMIT);
+            if (req.has_param("fields"))
+            {
+                std::stringstream ss(req.get_param_value("fields"));
+                std::string field;
+                while (std::getline(ss, field, ','))
+                {
+                    if (field != "id" && field != "name" && field != "info" &&
+                        field != "video" && field != "image" && field != "hls")
+                    {
+                        valid = false;
+                        break;
+                    }
+                    fields.push_back(field);
+                }
+            }
+            else
+            {
+                fields = {"id", "name", "info", "video", "image", "hls"};
+            }
+            if (valid == false || fields.empty())
+            {
+                // 返回 400 错误响应
+                rsp.status = 400;
+                rsp.body = R"({"result":false, "reason":"分页查询参数错误"})";
+                rsp.set_header("Content-Type", "application/json");
+                return;
+            }
+            // 查询这一页的视频信息，如果查询失败
+            Json::Value videos;
+            bool more = false;
+            int last_id = 0;
+            if (video_cache->SelectPage((int)after_id, (size_t)limit, fields, &videos, &more, &last_id) == false)
+            {
+                // 返回 500 错误响应
+                rsp.status = 500;
+                rsp.body = R"({"result":false, "reason":"查询数据库所有视频信息失败"})";
+                rsp.set_header("Content-Type", "application/json");
+                return;
+            }
+            // 后面还有数据时，通过 Link 头告诉客户端下一页的地址
+            if (more)
+            {
+                std::string next = "/video?after_id=" + std::to_string(last_id) +
+                                   "&limit=" + std::to_string(limit);
+                if (req.has_param("fields"))
+                {
+                    next += "&fields=" + req.get_param_value("fields");
+                }
+                rsp.set_header("Link", "<" + next + ">; rel=\"next\"");
+            }
+            // 将查询到的视频列表序列化为 JSON 字符串
+            JsonUtil::Serialize(videos, &rsp.body);
+            // 设置响应的内容类型为 JSON
+            rsp.set_header("Content-Type", "application/json");
+            return;
+        }
+
         // 处理 POST 请求，用于插入新的视频信息
-        static void Insert(const httplib::Request &req, httplib::Response &rsp)
+        // 上传的数据边接收边处理：视频和图片文件分块写入临时文件，文本字段保存在内存中
+        static void Insert(const httplib::Request &req, httplib::Response &rsp,
+                           const httplib::ContentReader &content_reader)
         {
-            // 检查请求中是否包含必要的文件信息（视频名称、简介、视频文件、图片文件）
-            if (req.has_file("name") == false ||
-                req.has_file("info") == false ||
-                req.has_file("video") == false ||
-                req.has_file("image") == false)
+            // 只接受 multipart/form-data 格式的上传
+            if (req.is_multipart_form_data() == false)
+            {
+                // 返回 400 错误响应
+                rsp.status = 400;
+                rsp.body = R"({"result":false, "reason":"上传的数据信息错误"})";
+                rsp.set_header("Content-Type", "application/json");
+                return;
+            }
+            // 构建静态资源根目录
+            std::string root = WWWROOT;
+            // 视频和图片先写入临时目录下的临时文件
+            ChunkFileWriter video(UPLOAD_TEMP_ROOT);
+            ChunkFileWriter image(UPLOAD_TEMP_ROOT);
+            // 保存视频和图片的原始文件名
+            std::string video_filename, image_filename;
+            // 保存文本字段（视频名称、简介）的内容
+            std::map<std::string, std::string> fields;
+            // 当前正在接收的字段名称和要写入的文件
+            std::string curr_name;
+            ChunkFileWriter *curr_file = NULL;
+            // 逐个接收 multipart 中的各个部分
+            bool ret = content_reader(
+                [&](const httplib::MultipartFormData &file)
+                {
+                    curr_name = file.name;
+                    curr_file = NULL;
+                    if (file.name == "video")
+                    {
+                        curr_file = &video;
+                        video_filename = file.filename;
+                    }
+                    else if (file.name == "image")
+                    {
+                        curr_file = &image;
+                        image_filename = file.filename;
+                    }
+                    // 同一个文件字段只允许出现一次
+                    if (curr_file != NULL)
+                    {
+                        return curr_file->Open();
+                    }
+                    fields[curr_name].clear();
+                    return true;
+                },
+                [&](const char *data, size_t len)
+                {
+                    if (curr_file != NULL)
+                    {
+                        return curr_file->Write(data, len);
+                    }
+                    // 文本字段不能无限增长
+                    std::string &field = fields[curr_name];
+                    if (field.size() + len > UPLOAD_FIELD_MAX)
+                    {
+                        return false;
+                    }
+                    field.append(data, len);
+                    return true;
+                });
+            // 检查上传是否完整，以及是否包含必要信息（视频名称、简介、视频文件、图片文件）
+            if (ret == false ||
+                fields.count("name") == 0 ||
+                fields.count("info") == 0 ||
+                video.IsOpen() == false ||
+                image.IsOpen() == false)
             {
                 // 如果缺少必要信息，返回 400 错误响应
                 rsp.status = 400;
@@ -38,27 +229,17 @@ namespace vod
                 rsp.set_header("Content-Type", "application/json");
                 return;
             }
-            // 从请求中获取视频名称的文件信息
-            httplib::MultipartFormData name = req.get_file_value("name");
-            // 从请求中获取视频简介的文件信息
-            httplib::MultipartFormData info = req.get_file_value("info");
-            // 从请求中获取视频文件的信息
-            httplib::MultipartFormData video = req.get_file_value("video");
-            // 从请求中获取图片文件的信息
-            httplib::MultipartFormData image = req.get_file_value("image");
             // 提取视频名称
-            std::string video_name = name.content;
+            std::string video_name = fields["name"];
             // 提取视频简介
-            std::string video_info = info.content;
-            // 构建静态资源根目录
-            std::string root = WWWROOT;
+            std::string video_info = fields["info"];
             // 构建视频文件的存储路径
-            std::string video_path = root + VIDEO_ROOT + video_name + video.filename;
+            std::string video_path = root + VIDEO_ROOT + video_name + video_filename;
             // 构建图片文件的存储路径
-            std::string image_path = root + IMAGE_ROOT + video_name + image.filename;
+            std::string image_path = root + IMAGE_ROOT + video_name + image_filename;
 
-            // 将视频文件内容写入指定路径，如果写入失败
-            if (FileUtil(video_path).SetContent(video.content) == false)
+            // 将视频临时文件重命名到指定路径，如果失败
+            if (video.Commit(video_path) == false)
             {
                 // 返回 500 错误响应
                 rsp.status = 500;
@@ -66,9 +247,11 @@ namespace vod
                 rsp.set_header("Content-Type", "application/json");
                 return;
             }
-            // 将图片文件内容写入指定路径，如果写入失败
-            if (FileUtil(image_path).SetContent(image.content) == false)
+            // 将图片临时文件重命名到指定路径，如果失败
+            if (image.Commit(image_path) == false)
             {
+                // 已经提交的视频文件不再有记录引用，删除它
+                remove(video_path.c_str());
                 // 返回 500 错误响应
                 rsp.status = 500;
                 rsp.body = R"({"result":false, "reason":"图片文件存储失败"})";
@@ -82,18 +265,24 @@ namespace vod
             // 设置视频简介
             video_json["info"] = video_info;
             // 设置视频文件的相对路径
-            video_json["video"] = VIDEO_ROOT + video_name + video.filename;
+            video_json["video"] = VIDEO_ROOT + video_name + video_filename;
             // 设置图片文件的相对路径
-            video_json["image"] = IMAGE_ROOT + video_name + image.filename;
+            video_json["image"] = IMAGE_ROOT + video_name + image_filename;
             // 将视频信息插入数据库，如果插入失败
-            if (tb_video->Insert(video_json) == false)
+            int video_id = 0;
+            if (video_cache->Insert(video_json, &video_id) == false)
             {
+                // 删除已经提交的视频和图片文件
+                remove(video_path.c_str());
+                remove(image_path.c_str());
                 // 返回 500 错误响应
                 rsp.status = 500;
                 rsp.body = R"({"result":false, "reason":"数据库新增数据失败"})";
                 rsp.set_header("Content-Type", "application/json");
                 return;
             }
+            // 在后台把视频切成 HLS 切片，切好之前页面先播放原始文件
+            hls_pipeline->Submit(video_id, video_path);
             // 插入成功后，重定向到首页
             rsp.set_redirect("/index.html", 303);
             return;
@@ -103,11 +292,11 @@ namespace vod
         static void Delete(const httplib::Request &req, httplib::Response &rsp)
         {
             // 从请求中提取要删除的视频 ID
-            int video_id = std::stoi(req.matches[1]);
+            int video_id = std::stoi(req.path_params.at("id"));
             // 创建一个 Json::Value 对象，用于存储查询到的视频信息
             Json::Value video;
             // 根据视频 ID 查询视频信息，如果查询失败
-            if (tb_video->SelectOne(video_id, &video) == false)
+            if (video_cache->SelectOne(video_id, &video) == false)
             {
                 // 返回 500 错误响应
                 rsp.status = 500;
@@ -121,12 +310,8 @@ namespace vod
             std::string video_path = root + video["video"].asString();
             // 构建要删除的图片文件的路径
             std::string image_path = root + video["image"].asString();
-            // 删除视频文件
-            remove(video_path.c_str());
-            // 删除图片文件
-            remove(image_path.c_str());
-            // 从数据库中删除该视频信息，如果删除失败
-            if (tb_video->Delete(video_id) == false)
+            // 先从数据库中删除该视频信息，其他工作进程中的切片任务发现视频不在了就会停下来；如果删除失败
+            if (video_cache->Delete(video_id) == false)
             {
                 // 返回 500 错误响应
                 rsp.status = 500;
@@ -134,6 +319,12 @@ namespace vod
                 rsp.set_header("Content-Type", "application/json");
                 return;
             }
+            // 删除视频文件
+            remove(video_path.c_str());
+            // 删除图片文件
+            remove(image_path.c_str());
+            // 停止还在进行的切片，切片目录由切片线程在后台清理
+            hls_pipeline->Remove(video_id);
             return;
         }
 
@@ -141,7 +332,7 @@ namespace vod
         static void Update(const httplib::Request &req, httplib::Response &rsp)
         {
             // 从请求中提取要更新的视频 ID
-            int video_id = std::stoi(req.matches[1]);
+            int video_id = std::stoi(req.path_params.at("id"));
             // 创建一个 Json::Value 对象，用于存储更新后的视频信息
             Json::Value video;
             // 将请求体中的 JSON 数据解析到 video 对象中，如果解析失败
@@ -154,7 +345,7 @@ namespace vod
                 return;
             }
             // 更新数据库中该视频的信息，如果更新失败
-            if (tb_video->Update(video_id, video) == false)
+            if (video_cache->Update(video_id, video) == false)
             {
                 // 返回 500 错误响应
                 rsp.status = 500;
@@ -169,11 +360,11 @@ namespace vod
         static void SelectOne(const httplib::Request &req, httplib::Response &rsp)
         {
             // 从请求中提取要查询的视频 ID
-            int video_id = std::stoi(req.matches[1]);
+            int video_id = std::stoi(req.path_params.at("id"));
             // 创建一个 Json::Value 对象，用于存储查询到的视频信息
             Json::Value video;
             // 根据视频 ID 查询视频信息，如果查询失败
-            if (tb_video->SelectOne(video_id, &video) == false)
+            if (video_cache->SelectOne(video_id, &video) == false)
             {
                 // 返回 500 错误响应
                 rsp.status = 500;
@@ -191,6 +382,13 @@ namespace vod
         // 处理 GET 请求，用于查询所有视频信息或根据关键字模糊查询视频信息
         static void SelectAll(const httplib::Request &req, httplib::Response &rsp)
         {
+            // 带有分页参数时进行分页查询
+            if (req.has_param("search") == false &&
+                (req.has_param("after_id") || req.has_param("limit") || req.has_param("fields")))
+            {
+                SelectPage(req, rsp);
+                return;
+            }
             // 默认进行全量查询
             bool select_flag = true;
             // 存储查询关键字
@@ -208,8 +406,9 @@ namespace vod
             // 如果是全量查询
             if (select_flag == true)
             {
-                // 查询所有视频信息，如果查询失败
-                if (tb_video->SelectAll(&videos) == false)
+                // 直接使用缓存中序列化好的全部视频信息，如果获取失败
+                std::shared_ptr<const Catalog> catalog;
+                if (video_cache->SelectAll(&catalog) == false)
                 {
                     // 返回 500 错误响应
                     rsp.status = 500;
@@ -217,11 +416,27 @@ namespace vod
                     rsp.set_header("Content-Type", "application/json");
                     return;
                 }
+                // 客户端每次都要来确认数据是否有变化
+                rsp.set_header("ETag", catalog->etag);
+                rsp.set_header("Cache-Control", "no-cache");
+                // 客户端手里的数据还是最新的，返回 304 不带响应体
+                if (httplib::etag_matches(req, catalog->etag))
+                {
+                    rsp.status = 304;
+                    return;
+                }
+                // 响应体直接从共享的数据中发送，不再拷贝一份
+                rsp.set_content_provider(catalog->body.size(), "application/json",
+                    [catalog](size_t offset, size_t length, httplib::DataSink &sink)
+                    {
+                        return sink.write(catalog->body.data() + offset, length);
+                    });
+                return;
             }
             else
             {
-                // 根据关键字进行模糊查询，如果查询失败
-                if (tb_video->SelectLike(search_key, &videos) == false)
+                // 根据关键字在索引中搜索，如果查询失败
+                if (video_cache->Search(search_key, &videos) == false)
                 {
                     // 返回 500 错误响应
                     rsp.status = 500;
@@ -237,15 +452,66 @@ namespace vod
             return;
         }
 
+        // 把一个池的统计数据转成 JSON
+        static Json::Value PoolStatsJson(const httplib::PoolStats &stats)
+        {
+            Json::Value pool;
+            pool["acquires"] = (Json::UInt64)stats.acquires;
+            pool["hits"] = (Json::UInt64)stats.hits;
+            // 命中率：从池中取到的次数占全部申请次数的比例
+            pool["hit_rate"] = stats.acquires == 0 ? 0.0 : (double)stats.hits / stats.acquires;
+            pool["in_use"] = (Json::UInt64)stats.in_use;
+            pool["peak_in_use"] = (Json::UInt64)stats.peak_in_use;
+            pool["cached"] = (Json::UInt64)stats.cached;
+            pool["peak_cached"] = (Json::UInt64)stats.peak_cached;
+            return pool;
+        }
+
+        // 处理 GET 请求，返回请求对象池和接收缓冲区池的统计数据
+        // 请求对象按个数统计，缓冲区按字节统计；多进程模式下只是处理这个请求的工作进程的数据
+        static void MemoryStats(const httplib::Request &, httplib::Response &rsp)
+        {
+            httplib::AllocatorStats stats = httplib::allocator_stats();
+            Json::Value root;
+            root["pid"] = (int)getpid();
+            root["requests"] = PoolStatsJson(stats.requests);
+            root["responses"] = PoolStatsJson(stats.responses);
+            root["buffers"] = PoolStatsJson(stats.buffers);
+            JsonUtil::Serialize(root, &rsp.body);
+            rsp.set_header("Content-Type", "application/json");
+            rsp.set_header("Cache-Control", "no-store");
+        }
+
     public:
-        // 构造函数，初始化服务器监听的端口号
-        Server(int port) : _port(port) {}
+        // 构造函数，初始化服务器监听的端口号；传入共享版本号表示运行在多进程模式下，
+        // 多个工作进程用 SO_REUSEPORT 绑定同一个端口，由内核在它们之间分配连接；
+        // ready_fd 是通知主进程的管道，绑定端口后写入一个字节并关闭
+        Server(int port, SharedGeneration *shared = NULL, int ready_fd = -1)
+            : _port(port), _shared(shared), _ready_fd(ready_fd) {}
+
+        // 停止服务器，RunModule 随后返回；服务器还没有开始监听时返回 false，调用者稍后重试
+        bool Stop()
+        {
+            if (_srv.is_running() == false)
+            {
+                return false;
+            }
+            _srv.stop();
+            return true;
+        }
 
         // 启动服务器的主要方法
         bool RunModule()
         {
             // 创建 TableVideo 类的实例，用于管理视频表的数据库操作
             tb_video = new TableVideo();
+            // 创建 VideoCache 类的实例，并预先加载全部视频信息
+            video_cache = new VideoCache(tb_video);
+            if (_shared != NULL)
+            {
+                video_cache->Share(_shared);
+            }
+            video_cache->Init();
             // 创建静态资源根目录
             FileUtil(WWWROOT).CreateDirectory();
             // 构建视频文件存储的实际路径
@@ -257,21 +523,83 @@ namespace vod
             std::string image_real_path = root + IMAGE_ROOT;
             // 创建图片文件存储目录
             FileUtil(image_real_path).CreateDirectory();
-            // 设置静态资源的根目录
-            _srv.set_mount_point("/", WWWROOT);
+            // 创建上传临时文件目录
+            FileUtil(UPLOAD_TEMP_ROOT).CreateDirectory();
+            // 设置静态资源的根目录，页面每次都验证是否有更新
+            _srv.set_mount_point("/", WWWROOT, {{"Cache-Control", STATIC_CACHE_CONTROL}});
+            // 切片时的临时播放列表等以 . 开头的文件不对外提供
+            _srv.set_dot_files_hidden(true);
+            // 样式、脚本、字体、图片和视频很少变化，允许浏览器缓存一段时间
+            const char *assets[] = {"css", "js", "woff", "woff2", "ttf", "eot", "svg", "otf",
+                                    "png", "jpg", "jpeg", "gif", "ico", "webp", "mp4", "webm"};
+            for (const char *ext : assets)
+            {
+                _srv.set_file_extension_and_cache_control_mapping(ext, ASSET_CACHE_CONTROL);
+            }
+            // HLS 播放列表和切片的类型，切片生成后不再变化，也允许浏览器缓存
+            _srv.set_file_extension_and_mimetype_mapping("m3u8", "application/vnd.apple.mpegurl");
+            _srv.set_file_extension_and_mimetype_mapping("ts", "video/mp2t");
+            _srv.set_file_extension_and_mimetype_mapping("m4s", "video/iso.segment");
+            _srv.set_file_extension_and_cache_control_mapping("ts", ASSET_CACHE_CONTROL);
+            _srv.set_file_extension_and_cache_control_mapping("m4s", ASSET_CACHE_CONTROL);
+            // 缓存静态资源打开的文件和文件属性，小文件连同压缩后的内容一起放在内存中
+            _srv.set_file_cache(STATIC_FILE_CACHE_COUNT, STATIC_MEMORY_FILE_SIZE, STATIC_MEMORY_TOTAL_SIZE);
+            // 视频目录一直在写入上传的视频和 HLS 切片，不缓存也不监视它，免得频繁的文件事件拖累缓存
+            _srv.add_file_cache_exclusion(video_real_path);
             // 注册 POST 请求处理函数，用于插入新的视频信息
             _srv.Post("/video", Insert);
             // 注册 DELETE 请求处理函数，用于删除指定 ID 的视频信息
-            _srv.Delete("/video/(\\d+)", Delete);
+            _srv.Delete("/video/:id<int>", Delete);
             // 注册 PUT 请求处理函数，用于更新指定 ID 的视频信息
-            _srv.Put("/video/(\\d+)", Update);
+            _srv.Put("/video/:id<int>", Update);
             // 注册 GET 请求处理函数，用于查询指定 ID 的视频信息
-            _srv.Get("/video/(\\d+)", SelectOne);
+            _srv.Get("/video/:id<int>", SelectOne);
             // 注册 GET 请求处理函数，用于查询所有视频信息或根据关键字模糊查询视频信息
             _srv.Get("/video", SelectAll);
-            // 启动服务器，监听指定端口
-            _srv.listen("0.0.0.0", _port);
-            return true;
+            // 注册 GET 请求处理函数，用于查看内存池的命中率和内存峰值
+            _srv.Get("/stats/memory", MemoryStats);
+            // 使用工作窃取线程池执行请求，代替 httplib 默认的单队列线程池
+            bool pin = WORKER_PIN_CPU && _shared == NULL;
+            _srv.new_task_queue = [pin]
+            {
+                return new WorkStealingPool(WORKER_THREAD_COUNT, pin);
+            };
+            // 使用 epoll 事件循环处理连接，工作线程只用来执行请求
+            _srv.set_event_loop(IO_THREAD_COUNT);
+            if (_shared != NULL)
+            {
+                // 允许多个工作进程监听同一个端口，平滑重启时新旧进程也能同时监听
+                _srv.set_socket_options([](socket_t sock)
+                {
+                    int yes = 1;
+                    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+                    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+                });
+            }
+            // 启动视频切片流水线，补切还没有切片的视频
+            hls_pipeline = new HlsPipeline(video_cache, WWWROOT, VIDEO_ROOT, HLS_WORK_ROOT);
+            hls_pipeline->Start();
+            // 绑定并监听指定端口，之后到达的连接由内核排队，不会被拒绝
+            if (_srv.bind_to_port("0.0.0.0", _port) == false)
+            {
+                hls_pipeline->Stop();
+                LOG(ERROR, "LISTEN PORT %d FAILED!\n", _port);
+                return false;
+            }
+            // 通知主进程本进程已经可以接收连接，平滑重启时主进程等到这时才停止旧的工作进程
+            if (_ready_fd >= 0)
+            {
+                char ready = 1;
+                ssize_t n = write(_ready_fd, &ready, 1);
+                (void)n;
+                close(_ready_fd);
+                _ready_fd = -1;
+            }
+            // 开始接收连接，被 Stop 停止时返回 true
+            bool ret = _srv.listen_after_bind();
+            // 服务器停止后终止正在运行的 ffmpeg
+            hls_pipeline->Stop();
+            return ret;
         }
     };
 }
\ No newline at end of file
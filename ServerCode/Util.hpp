@@ -7,7 +7,13 @@
 #include <sstream>
 #include <memory>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <jsoncpp/json/json.h>
 
@@ -140,6 +146,193 @@ namespace vod
             mkdir(_name.c_str(), 0777);
             return true;
         } // 针对目录时创建目录
+
+        // 删除目录以及目录下的所有内容
+        bool RemoveDirectory()
+        {
+            DIR *dir = opendir(_name.c_str());
+            if (dir == NULL)
+            {
+                return errno == ENOENT;
+            }
+            struct dirent *ent;
+            while ((ent = readdir(dir)) != NULL)
+            {
+                std::string child = ent->d_name;
+                if (child == "." || child == "..")
+                {
+                    continue;
+                }
+                child = _name + "/" + child;
+                // 子目录递归删除，其他的直接删除
+                struct stat st;
+                if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+                {
+                    FileUtil(child).RemoveDirectory();
+                }
+                else
+                {
+                    unlink(child.c_str());
+                }
+            }
+            closedir(dir);
+            if (rmdir(_name.c_str()) != 0)
+            {
+                LOG(ERROR, "REMOVE DIRECTORY FAILED: %s\n", _name.c_str());
+                return false;
+            }
+            return true;
+        } // 删除目录
+    };
+
+    // 定义分块写入时缓冲区的大小，缓冲区满了才真正写一次磁盘
+    #define CHUNK_WRITE_SIZE (1024 * 1024)
+
+    // 定义一个分块写文件的工具类 ChunkFileWriter
+    // 数据先写入同目录下的临时文件，全部写完后再重命名为目标文件，
+    // 这样大文件不需要整个放在内存里，目录中也不会出现写了一半的文件
+    class ChunkFileWriter
+    {
+    private:
+        // 临时文件所在的目录
+        std::string _dir;
+        // 临时文件的路径名称
+        std::string _temp_name;
+        // 临时文件的文件描述符
+        int _fd;
+        // 写缓冲区
+        std::vector<char> _buffer;
+        // 写缓冲区中已有数据的长度
+        size_t _used;
+        // 已经写入的数据总长度
+        size_t _size;
+
+    public:
+        // 构造函数，接收临时文件所在的目录
+        ChunkFileWriter(const std::string &dir) : _dir(dir), _fd(-1), _used(0), _size(0) {}
+
+        // 析构函数，没有提交的临时文件直接删除
+        ~ChunkFileWriter()
+        {
+            this->Discard();
+        }
+
+        ChunkFileWriter(const ChunkFileWriter &) = delete;
+        ChunkFileWriter &operator=(const ChunkFileWriter &) = delete;
+
+        // 判断临时文件是否已经创建
+        bool IsOpen() const { return _fd != -1; }
+
+        // 获取已经写入的数据总长度
+        size_t Size() const { return _size; }
+
+        // 在目录下创建一个唯一的临时文件
+        bool Open()
+        {
+            if (this->IsOpen())
+            {
+                return false;
+            }
+            std::string name = _dir + ".upload-XXXXXX";
+            _fd = mkstemp(&name[0]);
+            if (_fd < 0)
+            {
+                // 记录一条错误级别的日志，表示创建临时文件失败
+                LOG(ERROR, "CREATE TEMP FILE FAILED!\n");
+                return false;
+            }
+            // mkstemp 创建的文件只有属主可读写，这里改成普通文件的权限
+            fchmod(_fd, 0644);
+            _temp_name = name;
+            _buffer.resize(CHUNK_WRITE_SIZE);
+            _used = 0;
+            _size = 0;
+            return true;
+        }
+
+        // 追加写入一块数据，缓冲区满了才落盘
+        bool Write(const char *data, size_t len)
+        {
+            if (this->IsOpen() == false)
+            {
+                return false;
+            }
+            while (len > 0)
+            {
+                size_t n = std::min(len, _buffer.size() - _used);
+                memcpy(&_buffer[_used], data, n);
+                _used += n;
+                _size += n;
+                data += n;
+                len -= n;
+                if (_used == _buffer.size() && this->Flush() == false)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 将缓冲区中的数据全部写入文件
+        bool Flush()
+        {
+            size_t off = 0;
+            while (off < _used)
+            {
+                ssize_t ret = ::write(_fd, &_buffer[off], _used - off);
+                if (ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (ret <= 0)
+                {
+                    // 记录一条错误级别的日志，表示写入文件内容失败
+                    LOG(ERROR, "WRITE FILE  CONTENT FAILED!\n");
+                    return false;
+                }
+                off += ret;
+            }
+            _used = 0;
+            return true;
+        }
+
+        // 写入完成，将临时文件重命名为目标文件
+        bool Commit(const std::string &name)
+        {
+            if (this->IsOpen() == false || this->Flush() == false)
+            {
+                return false;
+            }
+            close(_fd);
+            _fd = -1;
+            if (rename(_temp_name.c_str(), name.c_str()) != 0)
+            {
+                // 记录一条错误级别的日志，表示重命名文件失败
+                LOG(ERROR, "RENAME FILE FAILED!\n");
+                unlink(_temp_name.c_str());
+                _temp_name.clear();
+                return false;
+            }
+            _temp_name.clear();
+            return true;
+        }
+
+        // 放弃写入，关闭并删除临时文件
+        void Discard()
+        {
+            if (this->IsOpen())
+            {
+                close(_fd);
+                _fd = -1;
+            }
+            if (_temp_name.empty() == false)
+            {
+                unlink(_temp_name.c_str());
+                _temp_name.clear();
+            }
+            std::vector<char>().swap(_buffer);
+            _used = 0;
+        }
     };
 
     // 定义一个 JSON 数据处理工具类 JsonUtil
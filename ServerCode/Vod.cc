@@ -1,16 +1,337 @@
 #include "Server.hpp"
 #include "../Log.hpp"
+#include <map>
+#include <vector>
+#include <thread>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using namespace log_es;
 
+// 定义服务器监听的端口
+#define SERVER_PORT 8899
+// 定义默认的工作进程数，0 表示不创建工作进程，在当前进程中直接运行服务器；
+// 可以通过第一个命令行参数覆盖
+#define WORKER_PROCESS_COUNT 0
+// 定义工作进程异常退出后，距离上次重启不足这个秒数时先等待再重启，避免反复崩溃占满 CPU
+#define WORKER_RESPAWN_DELAY 1
+
+// 主进程收到的信号，由信号处理函数设置，主循环中处理
+static volatile sig_atomic_t g_reload = 0;
+static volatile sig_atomic_t g_quit = 0;
+
+// 主进程的信号处理函数，只记录收到的信号
+static void OnSignal(int sig)
+{
+    if (sig == SIGHUP)
+    {
+        g_reload = 1;
+    }
+    else if (sig == SIGTERM || sig == SIGINT)
+    {
+        g_quit = 1;
+    }
+}
+
 void ServerStart()
 {
-    vod::Server server(8899);
+    vod::Server server(SERVER_PORT);
     LOG(INFO, "SERVER START\n");
     server.RunModule();
 }
-int main()
+
+// 主进程记录的一个工作进程
+struct WorkerInfo
+{
+    // 所属的代
+    int generation;
+    // 等待就绪通知的管道读端，收到通知或者管道关闭后为 -1
+    int ready_fd;
+    // 是否已经绑定端口，可以接收连接
+    bool ready;
+    // 是否已经通知它退出
+    bool stopping;
+};
+
+// 工作进程的入口：屏蔽退出信号，由单独的线程等待信号并停止服务器，让正在处理的请求完成
+// ready_fd 是通知主进程已经可以接收连接的管道写端
+static int WorkerStart(vod::SharedGeneration *shared, int ready_fd)
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    // 之后创建的线程都继承这个信号掩码
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    vod::Server server(SERVER_PORT, shared, ready_fd);
+    std::thread waiter([&server, set]()
+    {
+        int sig = 0;
+        sigwait(&set, &sig);
+        LOG(INFO, "WORKER %d STOPPING\n", (int)getpid());
+        // 服务器可能还在加载缓存，等它开始监听之后再停止
+        while (server.Stop() == false)
+        {
+            usleep(10 * 1000);
+        }
+    });
+    waiter.detach();
+    LOG(INFO, "WORKER %d START\n", (int)getpid());
+    return server.RunModule() ? 0 : 1;
+}
+
+// 创建一个工作进程，返回它的进程 id，失败时返回 -1；ready_fd 带回等待它就绪的管道读端
+static pid_t SpawnWorker(vod::SharedGeneration *shared, const sigset_t *old_mask, int *ready_fd)
+{
+    // 设置 O_CLOEXEC，工作进程启动的 ffmpeg 不会继承写端，工作进程退出时主进程能读到管道关闭
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        LOG(ERROR, "CREATE READY PIPE FAILED: %s\n", strerror(errno));
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        LOG(ERROR, "FORK WORKER FAILED: %s\n", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        // 子进程恢复默认的信号处理和信号掩码
+        signal(SIGHUP, SIG_IGN);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        sigprocmask(SIG_SETMASK, old_mask, NULL);
+        exit(WorkerStart(shared, fds[1]));
+    }
+    close(fds[1]);
+    *ready_fd = fds[0];
+    return pid;
+}
+
+// 创建一个工作进程并记录下来
+static void AddWorker(std::map<pid_t, WorkerInfo> &workers, int generation,
+                      vod::SharedGeneration *shared, const sigset_t *old_mask)
+{
+    int ready_fd = -1;
+    pid_t pid = SpawnWorker(shared, old_mask, &ready_fd);
+    if (pid > 0)
+    {
+        workers[pid] = {generation, ready_fd, false, false};
+    }
+}
+
+// 读取 ppoll 报告的就绪通知：读到一个字节表示工作进程已经绑定端口，读到管道关闭表示它在就绪之前就退出了
+static void ReadReady(std::map<pid_t, WorkerInfo> &workers, const std::vector<struct pollfd> &fds)
+{
+    for (auto &pfd : fds)
+    {
+        if (pfd.revents == 0)
+        {
+            continue;
+        }
+        for (auto &it : workers)
+        {
+            WorkerInfo &worker = it.second;
+            if (worker.ready_fd != pfd.fd)
+            {
+                continue;
+            }
+            char ready = 0;
+            if (read(worker.ready_fd, &ready, 1) == 1)
+            {
+                worker.ready = true;
+            }
+            close(worker.ready_fd);
+            worker.ready_fd = -1;
+            break;
+        }
+    }
+}
+
+// 当前一代的工作进程是否都已经就绪
+static bool GenerationReady(const std::map<pid_t, WorkerInfo> &workers, int generation, int count)
+{
+    int ready = 0;
+    for (auto &it : workers)
+    {
+        if (it.second.generation == generation && it.second.ready)
+        {
+            ready++;
+        }
+    }
+    return ready >= count;
+}
+
+// 关闭记录中剩下的管道读端
+static void CloseReadyFd(WorkerInfo &worker)
+{
+    if (worker.ready_fd >= 0)
+    {
+        close(worker.ready_fd);
+        worker.ready_fd = -1;
+    }
+}
+
+// 通知不属于 keep 这一代的工作进程退出，keep 小于 0 时通知所有工作进程
+static void StopWorkers(std::map<pid_t, WorkerInfo> &workers, int keep)
 {
-    ServerStart();
+    for (auto &it : workers)
+    {
+        if (it.second.stopping == false && (keep < 0 || it.second.generation != keep))
+        {
+            it.second.stopping = true;
+            kill(it.first, SIGTERM);
+        }
+    }
+}
+
+// 主进程：创建工作进程并监控它们
+// SIGHUP 平滑重启：先创建新一代工作进程，等它们都绑定端口之后，再让旧的工作进程处理完手上的请求后退出；
+// 新的工作进程就绪之前旧的一直在接收连接，新进程启动失败时旧进程也不会被停掉；
+// SIGTERM/SIGINT 转发给所有工作进程，等它们都退出后主进程退出；
+// 当前一代的工作进程意外退出时重新创建
+static int MasterStart(int count)
+{
+    // 数据库连接池和缓存在工作进程中创建，主进程只创建共享的缓存版本号
+    vod::SharedGeneration *shared = vod::CreateSharedGeneration();
+    if (shared == NULL)
+    {
+        return 1;
+    }
+    // 处理信号期间屏蔽它们，只在 ppoll 中接收，避免丢失信号
+    sigset_t block, old_mask;
+    sigemptyset(&block);
+    sigaddset(&block, SIGHUP);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &old_mask);
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = OnSignal;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGHUP, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGCHLD, &act, NULL);
+
+    // 工作进程 id -> 工作进程的信息
+    std::map<pid_t, WorkerInfo> workers;
+    int generation = 0;
+    // 是否还有旧的工作进程在等新一代就绪
+    bool reloading = false;
+    time_t last_respawn = 0;
+    LOG(INFO, "MASTER %d START %d WORKERS\n", (int)getpid(), count);
+    for (int i = 0; i < count; i++)
+    {
+        AddWorker(workers, generation, shared, &old_mask);
+    }
+    bool quitting = false;
+    while (quitting == false || workers.empty() == false)
+    {
+        // 等待信号或者就绪通知，ppoll 期间恢复原来的信号掩码，和 sigsuspend 一样不会丢失信号
+        std::vector<struct pollfd> fds;
+        for (auto &it : workers)
+        {
+            if (it.second.ready_fd >= 0)
+            {
+                fds.push_back({it.second.ready_fd, POLLIN, 0});
+            }
+        }
+        if (ppoll(fds.data(), fds.size(), NULL, &old_mask) > 0)
+        {
+            ReadReady(workers, fds);
+        }
+        if (g_quit && quitting == false)
+        {
+            LOG(INFO, "MASTER STOPPING\n");
+            quitting = true;
+            StopWorkers(workers, -1);
+        }
+        if (g_reload && quitting == false)
+        {
+            LOG(INFO, "MASTER RELOADING\n");
+            generation++;
+            reloading = true;
+            for (int i = 0; i < count; i++)
+            {
+                AddWorker(workers, generation, shared, &old_mask);
+            }
+        }
+        g_reload = 0;
+        // 回收所有退出的工作进程
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            auto it = workers.find(pid);
+            if (it == workers.end())
+            {
+                continue;
+            }
+            bool current = it->second.generation == generation;
+            bool ready = it->second.ready;
+            CloseReadyFd(it->second);
+            workers.erase(it);
+            if (quitting || current == false)
+            {
+                LOG(INFO, "WORKER %d EXITED\n", (int)pid);
+                continue;
+            }
+            if (ready == false)
+            {
+                LOG(ERROR, "WORKER %d EXITED BEFORE READY\n", (int)pid);
+            }
+            if (WIFSIGNALED(status))
+            {
+                LOG(ERROR, "WORKER %d KILLED BY SIGNAL %d, RESPAWNING\n", (int)pid, WTERMSIG(status));
+            }
+            else
+            {
+                LOG(ERROR, "WORKER %d EXITED WITH %d, RESPAWNING\n", (int)pid, WEXITSTATUS(status));
+            }
+            time_t now = time(nullptr);
+            if (now - last_respawn < WORKER_RESPAWN_DELAY)
+            {
+                sleep(WORKER_RESPAWN_DELAY);
+            }
+            last_respawn = time(nullptr);
+            AddWorker(workers, generation, shared, &old_mask);
+        }
+        // 新一代的工作进程全部可以接收连接了，旧的工作进程停止监听并处理完剩下的请求
+        if (reloading && quitting == false && GenerationReady(workers, generation, count))
+        {
+            LOG(INFO, "WORKERS OF GENERATION %d READY\n", generation);
+            reloading = false;
+            StopWorkers(workers, generation);
+        }
+    }
+    LOG(INFO, "MASTER EXIT\n");
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[])
+{
+    int count = WORKER_PROCESS_COUNT;
+    if (argc > 1)
+    {
+        count = atoi(argv[1]);
+    }
+    if (count <= 0)
+    {
+        ServerStart();
+        return 0;
+    }
+    return MasterStart(count);
+}
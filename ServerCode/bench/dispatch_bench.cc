@@ -0,0 +1,137 @@
+// 接收连接到开始处理的延迟测试：对比 httplib 自带的 ThreadPool 和 vod::WorkStealingPool
+// 监听线程每 accept 一个连接就记下时间并提交任务，任务开始执行时计算经过的时间，
+// 和服务器中 accept 之后把连接交给线程池的路径一样
+// 用法：./dispatch_bench [工作线程数] [连接数] [客户端线程数] [每个任务的处理时间（微秒）]
+#include "../Scheduler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// 忙等一段时间，模拟处理请求
+static void Spin(int usec)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(usec);
+    while (Clock::now() < end)
+    {
+    }
+}
+
+// 在回环地址的随机端口上监听，返回端口号
+static int Listen(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0)
+    {
+        perror("listen");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// 客户端：不停地建立连接，等服务端处理完关闭连接后再建立下一个
+static void Client(int port, std::atomic<int> *left)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    while (left->fetch_sub(1) > 0)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        char c;
+        while (recv(fd, &c, 1, 0) > 0)
+        {
+        }
+        close(fd);
+    }
+}
+
+// 用一个线程池处理 conns 个连接，打印延迟的分位数
+static void Run(const char *name, httplib::TaskQueue *pool, int conns, int clients, int work_us)
+{
+    int port = 0;
+    int lfd = Listen(&port);
+    std::vector<double> latency(conns);
+    std::atomic<int> left(conns);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++)
+    {
+        threads.emplace_back(Client, port, &left);
+    }
+    Clock::time_point begin = Clock::now();
+    for (int i = 0; i < conns; i++)
+    {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0)
+        {
+            perror("accept");
+            exit(1);
+        }
+        Clock::time_point accepted = Clock::now();
+        double *slot = &latency[i];
+        pool->enqueue([fd, accepted, slot, work_us]()
+                      {
+                          *slot = std::chrono::duration<double, std::micro>(Clock::now() - accepted).count();
+                          Spin(work_us);
+                          close(fd);
+                      });
+    }
+    pool->shutdown();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    close(lfd);
+
+    std::sort(latency.begin(), latency.end());
+    auto at = [&](double q)
+    {
+        return latency[std::min(latency.size() - 1, (size_t)(q * latency.size()))];
+    };
+    printf("%-18s %8.0f conn/s  p50 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  max %8.1f us\n",
+           name, conns / seconds, at(0.50), at(0.99), at(0.999), latency.back());
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : (int)std::max(8u, std::thread::hardware_concurrency());
+    int conns = argc > 2 ? atoi(argv[2]) : 20000;
+    int clients = argc > 3 ? atoi(argv[3]) : 32;
+    int work_us = argc > 4 ? atoi(argv[4]) : 20;
+    printf("threads %d, connections %d, clients %d, work %d us\n", threads, conns, clients, work_us);
+
+    std::unique_ptr<httplib::TaskQueue> pool(new httplib::ThreadPool(threads));
+    Run("ThreadPool", pool.get(), conns, clients, work_us);
+    pool.reset(new vod::WorkStealingPool(threads));
+    Run("WorkStealingPool", pool.get(), conns, clients, work_us);
+    return 0;
+}
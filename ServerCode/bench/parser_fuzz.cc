@@ -0,0 +1,269 @@
+// 解析函数的差分模糊测试：手写的 parse_range_header、parse_content_disposition、
+// parse_status_line、parse_auth_params 和原来基于 std::regex 的实现比较，结果必须完全相同
+// 输入由各自格式中的词随机拼接而成，Range 另外生成一批格式正确的多段请求
+// 用法：./parser_fuzz [每种输入的次数] [随机数种子]，有差异时打印输入并返回 1
+#include "../httplib.h"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+// 以下是改成手写解析之前 httplib.h 中的实现，只改了函数名
+namespace regex_parsers
+{
+
+#ifdef CPPHTTPLIB_NO_EXCEPTIONS
+inline bool parse_range_header(const std::string &s, httplib::Ranges &ranges) {
+#else
+inline bool parse_range_header(const std::string &s, httplib::Ranges &ranges) try {
+#endif
+  static auto re_first_range = std::regex(R"(bytes=(\d*-\d*(?:,\s*\d*-\d*)*))");
+  std::smatch m;
+  if (std::regex_match(s, m, re_first_range)) {
+    auto pos = static_cast<size_t>(m.position(1));
+    auto len = static_cast<size_t>(m.length(1));
+    bool all_valid_ranges = true;
+    httplib::detail::split(&s[pos], &s[pos + len], ',', [&](const char *b, const char *e) {
+      if (!all_valid_ranges) return;
+      static auto re_another_range = std::regex(R"(\s*(\d*)-(\d*))");
+      std::cmatch cm;
+      if (std::regex_match(b, e, cm, re_another_range)) {
+        ssize_t first = -1;
+        if (!cm.str(1).empty()) {
+          first = static_cast<ssize_t>(std::stoll(cm.str(1)));
+        }
+
+        ssize_t last = -1;
+        if (!cm.str(2).empty()) {
+          last = static_cast<ssize_t>(std::stoll(cm.str(2)));
+        }
+
+        if (first != -1 && last != -1 && first > last) {
+          all_valid_ranges = false;
+          return;
+        }
+        ranges.emplace_back(std::make_pair(first, last));
+      }
+    });
+    return all_valid_ranges;
+  }
+  return false;
+#ifdef CPPHTTPLIB_NO_EXCEPTIONS
+}
+#else
+} catch (...) { return false; }
+#endif
+
+// MultipartFormDataParser::parse 中对 Content-Disposition 行的处理
+inline bool parse_content_disposition(const std::string &header,
+                                      std::string &name,
+                                      std::string &filename) {
+  static const std::regex re_content_disposition(
+      "^Content-Disposition:\\s*form-data;\\s*name=\"(.*?)\"(?:;\\s*filename="
+      "\"(.*?)\")?\\s*$",
+      std::regex_constants::icase);
+  std::smatch m;
+  if (std::regex_match(header, m, re_content_disposition)) {
+    name = m[1];
+    filename = m[2];
+    return true;
+  }
+  return false;
+}
+
+// ClientImpl::read_response_line 中对状态行的处理
+inline bool parse_status_line(const char *s, httplib::Response &res) {
+#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+  const static std::regex re("(HTTP/1\\.[01]) (\\d{3})(?: (.*?))?\r\n");
+#else
+  const static std::regex re("(HTTP/1\\.[01]) (\\d{3})(?: (.*?))?\r?\n");
+#endif
+
+  std::cmatch m;
+  if (!std::regex_match(s, m, re)) { return false; }
+  res.version = std::string(m[1]);
+  res.status = std::stoi(std::string(m[2]));
+  res.reason = std::string(m[3]);
+  return true;
+}
+
+// parse_www_authenticate 中对 Digest 参数的处理
+inline void parse_auth_params(const std::string &s,
+                              std::map<std::string, std::string> &auth) {
+  static auto re = std::regex(R"~((?:(?:,\s*)?(.+?)=(?:"(.*?)"|([^,]*))))~");
+  auto beg = std::sregex_iterator(s.begin(), s.end(), re);
+  for (auto i = beg; i != std::sregex_iterator(); ++i) {
+    auto m = *i;
+    auto key = s.substr(static_cast<size_t>(m.position(1)),
+                        static_cast<size_t>(m.length(1)));
+    auto val = m.length(2) > 0
+                   ? s.substr(static_cast<size_t>(m.position(2)),
+                              static_cast<size_t>(m.length(2)))
+                   : s.substr(static_cast<size_t>(m.position(3)),
+                              static_cast<size_t>(m.length(3)));
+    auth[key] = val;
+  }
+}
+
+} // namespace regex_parsers
+
+static std::mt19937 rng;
+static int failures = 0;
+
+// 从词表中随机取 1 到 max_tokens 个词拼接成输入
+static std::string Compose(const std::vector<std::string> &tokens, int max_tokens)
+{
+    std::string s;
+    int n = 1 + (int)(rng() % max_tokens);
+    for (int i = 0; i < n; i++)
+    {
+        s += tokens[rng() % tokens.size()];
+    }
+    return s;
+}
+
+// 把控制字符转义后打印
+static std::string Escape(const std::string &s)
+{
+    std::string out;
+    for (unsigned char c : s)
+    {
+        if (c == '\r')
+        {
+            out += "\\r";
+        }
+        else if (c == '\n')
+        {
+            out += "\\n";
+        }
+        else if (c < 0x20 || c >= 0x7f)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\x%02x", c);
+            out += buf;
+        }
+        else
+        {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+static void Report(const char *parser, const std::string &input)
+{
+    if (failures++ < 20)
+    {
+        printf("MISMATCH %s: \"%s\"\n", parser, Escape(input).c_str());
+    }
+}
+
+static void CheckRange(const std::string &s)
+{
+    httplib::Ranges a, b;
+    bool ra = regex_parsers::parse_range_header(s, a);
+    bool rb = httplib::detail::parse_range_header(s, b);
+    if (ra != rb || (ra && a != b))
+    {
+        Report("parse_range_header", s);
+    }
+}
+
+static void CheckContentDisposition(const std::string &s)
+{
+    std::string name_a, file_a, name_b, file_b;
+    bool ra = regex_parsers::parse_content_disposition(s, name_a, file_a);
+    bool rb = httplib::detail::parse_content_disposition(s.data(), s.data() + s.size(), name_b, file_b);
+    if (ra != rb || (ra && (name_a != name_b || file_a != file_b)))
+    {
+        Report("parse_content_disposition", s);
+    }
+}
+
+static void CheckStatusLine(const std::string &s)
+{
+    httplib::Response a, b;
+    bool ra = regex_parsers::parse_status_line(s.c_str(), a);
+    bool rb = httplib::detail::parse_status_line(s.c_str(), b);
+    if (ra != rb || (ra && (a.version != b.version || a.status != b.status || a.reason != b.reason)))
+    {
+        Report("parse_status_line", s);
+    }
+}
+
+static void CheckAuthParams(const std::string &s)
+{
+    std::map<std::string, std::string> a, b;
+    regex_parsers::parse_auth_params(s, a);
+    httplib::detail::parse_auth_params(s, b);
+    if (a != b)
+    {
+        Report("parse_auth_params", s);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 300000;
+    unsigned seed = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 1;
+    rng.seed(seed);
+
+    std::vector<std::string> range_tokens = {
+        "bytes=", "bytes", "=", "0", "1", "9", "42", "1000", "9223372036854775807",
+        "9223372036854775808", "99999999999999999999", "-", "-", ",", ", ", " ", "\t",
+        "\r", "\n", "\v", "x", "+", "00"};
+    std::vector<std::string> disposition_tokens = {
+        "Content-Disposition:", "content-disposition:", "CONTENT-DISPOSITION:", "form-data;",
+        "Form-Data;", "name=\"", "NAME=\"", "filename=\"", "FileName=\"", "\"", ";", " ", "\t",
+        "\r", "\n", "a", "video.mp4", "x y", "=", "\"\"", "; "};
+    std::vector<std::string> status_tokens = {
+        "HTTP/1.1", "HTTP/1.0", "HTTP/1.2", "HTTP/2", "HTTP/1.", " ", "200", "404", "20",
+        "2000", "1a0", "OK", "Not Found", "\r\n", "\n", "\r", "x", "  "};
+    std::vector<std::string> auth_tokens = {
+        "realm", "nonce", "qop", "=", "\"", "\"auth,auth-int\"", "abc", "a b", ",", ", ",
+        " ", "\t", "\r", "\n", "x", "==", "\"\"", "opaque=\"5ccc\""};
+
+    for (int i = 0; i < n; i++)
+    {
+        std::string range = Compose(range_tokens, 10);
+        // 大部分输入以 bytes= 开头，才能走到后面的解析
+        if (rng() % 5 != 0)
+        {
+            range = "bytes=" + range;
+        }
+        CheckRange(range);
+
+        // 格式正确的多段 Range，数字可以省略，分隔符后面有随机的空白
+        std::string wellformed = "bytes=";
+        int parts = 1 + (int)(rng() % 6);
+        for (int k = 0; k < parts; k++)
+        {
+            if (k > 0)
+            {
+                wellformed += ",";
+                wellformed += std::string(rng() % 3, " \t\v"[rng() % 3]);
+            }
+            if (rng() % 4 != 0)
+            {
+                wellformed += std::to_string(rng() % 100000);
+            }
+            wellformed += "-";
+            if (rng() % 4 != 0)
+            {
+                wellformed += std::to_string(rng() % 100000);
+            }
+        }
+        CheckRange(wellformed);
+
+        CheckContentDisposition(Compose(disposition_tokens, 12));
+        CheckStatusLine(Compose(status_tokens, 8));
+        CheckAuthParams(Compose(auth_tokens, 12));
+    }
+
+    printf("%d inputs per parser (plus %d well-formed ranges), seed %u: %d mismatches\n",
+           n, n, seed, failures);
+    return failures == 0 ? 0 : 1;
+}
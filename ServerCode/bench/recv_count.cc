@@ -0,0 +1,69 @@
+// 统计接收数据的系统调用次数：用 LD_PRELOAD 加载后拦截 recv 和等待可读的 poll/select，
+// 进程退出时把总次数、接收的字节数和每 MB 的调用次数打印到标准错误
+// upload_bench 运行时会通过 recv_count_get 读取计数，按每次上传分别统计
+// 用法：LD_PRELOAD=./bench/recv_count.so ./bench/upload_bench
+//      LD_PRELOAD=./bench/recv_count.so ./vod     （统计真实服务器，停止服务器时打印）
+#include <atomic>
+#include <cstdio>
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+static std::atomic<unsigned long> recv_calls(0);
+static std::atomic<unsigned long> recv_bytes(0);
+static std::atomic<unsigned long> poll_calls(0);
+
+// 找到被拦截的原始函数
+template <typename Fn>
+static Fn Real(const char *name)
+{
+    return (Fn)dlsym(RTLD_NEXT, name);
+}
+
+extern "C" ssize_t recv(int fd, void *buf, size_t len, int flags)
+{
+    static auto real = Real<ssize_t (*)(int, void *, size_t, int)>("recv");
+    ssize_t n = real(fd, buf, len, flags);
+    recv_calls.fetch_add(1, std::memory_order_relaxed);
+    if (n > 0)
+    {
+        recv_bytes.fetch_add(n, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+extern "C" int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    static auto real = Real<int (*)(struct pollfd *, nfds_t, int)>("poll");
+    poll_calls.fetch_add(1, std::memory_order_relaxed);
+    return real(fds, nfds, timeout);
+}
+
+extern "C" int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+{
+    static auto real = Real<int (*)(int, fd_set *, fd_set *, fd_set *, struct timeval *)>("select");
+    poll_calls.fetch_add(1, std::memory_order_relaxed);
+    return real(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+// 供测试程序读取当前的计数
+extern "C" void recv_count_get(unsigned long *calls, unsigned long *bytes, unsigned long *polls)
+{
+    *calls = recv_calls.load();
+    *bytes = recv_bytes.load();
+    *polls = poll_calls.load();
+}
+
+__attribute__((destructor)) static void Report()
+{
+    unsigned long calls = recv_calls.load(), bytes = recv_bytes.load(), polls = poll_calls.load();
+    double mb = bytes / (1024.0 * 1024.0);
+    fprintf(stderr, "recv_count: %lu recv, %lu poll/select, %.1f MB received", calls, polls, mb);
+    if (mb >= 1)
+    {
+        fprintf(stderr, ", %.1f recv/MB, %.1f poll/MB", calls / mb, polls / mb);
+    }
+    fprintf(stderr, "\n");
+}
@@ -0,0 +1,110 @@
+// 路由匹配的微基准：对比原来逐个 std::regex_match 的路由表和现在的分段字典树路由
+// 路由和 Server::RunModule 中注册的 GET 路由相同，另外对比静态文件扩展名的提取
+// 用法：./route_bench [每种路径的匹配次数]
+#include "../httplib.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+typedef httplib::Server::Handler Handler;
+
+// 原来的路由表：按注册顺序逐个 regex_match，和改动之前的 Server::dispatch_request 相同
+class RegexRoutes
+{
+private:
+    std::vector<std::pair<std::regex, Handler>> _handlers;
+
+public:
+    void Add(const std::string &pattern, Handler handler)
+    {
+        _handlers.push_back(std::make_pair(std::regex(pattern), std::move(handler)));
+    }
+
+    const Handler *Match(httplib::Request &req) const
+    {
+        for (const auto &x : _handlers)
+        {
+            if (std::regex_match(req.path, req.matches, x.first))
+            {
+                return &x.second;
+            }
+        }
+        return NULL;
+    }
+};
+
+// 原来的扩展名提取
+static std::string RegexFileExtension(const std::string &path)
+{
+    std::smatch m;
+    static auto re = std::regex("\\.([a-zA-Z0-9]+)$");
+    if (std::regex_search(path, m, re))
+    {
+        return m[1].str();
+    }
+    return std::string();
+}
+
+// 执行 n 次 fn，返回每次的平均纳秒数
+template <typename Fn>
+static double Measure(int n, Fn fn)
+{
+    Clock::time_point begin = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / n;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    Handler handler = [](const httplib::Request &, httplib::Response &) {};
+
+    RegexRoutes before;
+    before.Add("/video/(\\d+)", handler);
+    before.Add("/video", handler);
+    before.Add("/stats/memory", handler);
+
+    httplib::detail::Router<Handler> after;
+    after.add("/video/:id<int>", handler);
+    after.add("/video", handler);
+    after.add("/stats/memory", handler);
+
+    // 每次匹配前清空上一次的结果，和每个请求使用新的 Request 一样
+    const char *paths[] = {"/video/123", "/video", "/stats/memory", "/index.html"};
+    size_t hits = 0;
+    printf("%-16s %12s %12s\n", "path", "regex ns", "router ns");
+    for (const char *path : paths)
+    {
+        httplib::Request req;
+        req.path = path;
+        double regex_ns = Measure(n, [&]()
+                                  {
+                                      req.matches = httplib::Match();
+                                      hits += before.Match(req) != NULL;
+                                  });
+        double router_ns = Measure(n, [&]()
+                                   {
+                                       req.path_params.clear();
+                                       hits += after.match(req) != NULL;
+                                   });
+        printf("%-16s %12.1f %12.1f\n", path, regex_ns, router_ns);
+    }
+
+    std::string file = "/www/js/app.min.js";
+    size_t len = 0;
+    double regex_ns = Measure(n, [&]()
+                              { len += RegexFileExtension(file).size(); });
+    double scan_ns = Measure(n, [&]()
+                             { len += httplib::detail::file_extension(file).size(); });
+    printf("%-16s %12.1f %12.1f\n", "file_extension", regex_ns, scan_ns);
+    // 使用结果，避免循环被编译器优化掉
+    return hits + len == 0 ? 1 : 0;
+}
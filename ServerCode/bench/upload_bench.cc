@@ -0,0 +1,162 @@
+// 上传吞吐量测试：向本进程中的 httplib 服务器上传 multipart 格式的大文件，
+// 服务器和 Server::Insert 一样用 content reader 逐块接收，打印每次上传的 MB/s；
+// 用 LD_PRELOAD 加载 recv_count.so 时同时打印每 MB 的 recv 和 poll 调用次数
+// upload_bench_4k 用固定的 4KB 接收缓冲区编译，作为改动之前的对照
+// 用法：LD_PRELOAD=./bench/recv_count.so ./bench/upload_bench [上传大小（MB）] [次数]
+#include "../httplib.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef std::chrono::steady_clock Clock;
+typedef void (*CountGetter)(unsigned long *, unsigned long *, unsigned long *);
+
+#define BOUNDARY "----vodbenchboundary"
+#define CHUNK_SIZE (1024 * 1024)
+
+// 把 len 字节全部发送出去
+static bool SendAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 上传一个 mb 兆字节的视频字段，返回服务器收到的字节数，失败返回 -1
+static long long Upload(int port, size_t mb, const std::vector<char> &chunk)
+{
+    std::string head = "--" BOUNDARY "\r\n"
+                       "Content-Disposition: form-data; name=\"video\"; filename=\"bench.mp4\"\r\n"
+                       "Content-Type: video/mp4\r\n\r\n";
+    std::string tail = "\r\n--" BOUNDARY "--\r\n";
+    size_t body = head.size() + mb * CHUNK_SIZE + tail.size();
+    std::string request = "POST /upload HTTP/1.1\r\n"
+                          "Host: 127.0.0.1\r\n"
+                          "Connection: close\r\n"
+                          "Content-Type: multipart/form-data; boundary=" BOUNDARY "\r\n"
+                          "Content-Length: " + std::to_string(body) + "\r\n\r\n" + head;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    bool ok = SendAll(fd, request.data(), request.size());
+    for (size_t i = 0; ok && i < mb; i++)
+    {
+        ok = SendAll(fd, chunk.data(), chunk.size());
+    }
+    ok = ok && SendAll(fd, tail.data(), tail.size());
+    // 服务器处理完后关闭连接，响应体是收到的字节数
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while (ok && (n = recv(fd, buf, sizeof(buf), 0)) > 0)
+    {
+        response.append(buf, n);
+    }
+    close(fd);
+    size_t pos = response.find("\r\n\r\n");
+    if (ok == false || response.compare(0, 12, "HTTP/1.1 200") != 0 || pos == std::string::npos)
+    {
+        return -1;
+    }
+    return atoll(response.c_str() + pos + 4);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t mb = argc > 1 ? atoi(argv[1]) : 200;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    httplib::Server srv;
+    srv.Post("/upload", [](const httplib::Request &, httplib::Response &rsp,
+                           const httplib::ContentReader &content_reader)
+             {
+                 long long total = 0;
+                 content_reader(
+                     [&](const httplib::MultipartFormData &)
+                     { return true; },
+                     [&](const char *, size_t n)
+                     {
+                         total += n;
+                         return true;
+                     });
+                 rsp.set_content(std::to_string(total), "text/plain");
+             });
+    int port = srv.bind_to_any_port("127.0.0.1");
+    std::thread server([&]()
+                       { srv.listen_after_bind(); });
+    while (srv.is_running() == false)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // 文件内容只有小写字母，不会和分隔符混淆
+    std::vector<char> chunk(CHUNK_SIZE);
+    for (size_t i = 0; i < chunk.size(); i++)
+    {
+        chunk[i] = (char)('a' + (i * 7919) % 26);
+    }
+    CountGetter get = (CountGetter)dlsym(RTLD_DEFAULT, "recv_count_get");
+    if (get == NULL)
+    {
+        printf("recv_count.so is not preloaded, only MB/s is reported\n");
+    }
+
+    std::vector<double> speeds;
+    for (int i = 0; i < runs; i++)
+    {
+        unsigned long calls0 = 0, bytes0 = 0, polls0 = 0, calls1 = 0, bytes1 = 0, polls1 = 0;
+        if (get != NULL)
+        {
+            get(&calls0, &bytes0, &polls0);
+        }
+        Clock::time_point begin = Clock::now();
+        long long received = Upload(port, mb, chunk);
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        if (received != (long long)(mb * CHUNK_SIZE))
+        {
+            printf("upload failed: server received %lld bytes\n", received);
+            return 1;
+        }
+        speeds.push_back(mb / seconds);
+        printf("run %d: %zu MB in %.3f s, %.0f MB/s", i + 1, mb, seconds, mb / seconds);
+        if (get != NULL)
+        {
+            get(&calls1, &bytes1, &polls1);
+            printf(", %.1f recv/MB, %.1f poll/MB", (double)(calls1 - calls0) / mb, (double)(polls1 - polls0) / mb);
+        }
+        printf("\n");
+    }
+    std::sort(speeds.begin(), speeds.end());
+    printf("median %.0f MB/s\n", speeds[speeds.size() / 2]);
+
+    srv.stop();
+    server.join();
+    return 0;
+}
@@ -80,10 +80,34 @@
 #define CPPHTTPLIB_RECV_BUFSIZ size_t(4096u)
 #endif
 
+#ifndef CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ
+#define CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ size_t(1024u * 1024u)
+#endif
+
+#ifndef CPPHTTPLIB_RECV_BUFFER_POOL_MAX
+#define CPPHTTPLIB_RECV_BUFFER_POOL_MAX size_t(16u * 1024u * 1024u)
+#endif
+
+#ifndef CPPHTTPLIB_THREAD_BUFFER_CACHE_MAX
+#define CPPHTTPLIB_THREAD_BUFFER_CACHE_MAX size_t(2u * 1024u * 1024u)
+#endif
+
+#ifndef CPPHTTPLIB_OBJECT_POOL_SIZE
+#define CPPHTTPLIB_OBJECT_POOL_SIZE 4
+#endif
+
+#ifndef CPPHTTPLIB_POOLED_BODY_CAPACITY_MAX
+#define CPPHTTPLIB_POOLED_BODY_CAPACITY_MAX size_t(64u * 1024u)
+#endif
+
 #ifndef CPPHTTPLIB_COMPRESSION_BUFSIZ
 #define CPPHTTPLIB_COMPRESSION_BUFSIZ size_t(16384u)
 #endif
 
+#ifndef CPPHTTPLIB_FILE_BUFSIZ
+#define CPPHTTPLIB_FILE_BUFSIZ size_t(65536u)
+#endif
+
 #ifndef CPPHTTPLIB_THREAD_POOL_COUNT
 #define CPPHTTPLIB_THREAD_POOL_COUNT                                           \
   ((std::max)(8u, std::thread::hardware_concurrency() > 0                      \
@@ -91,6 +115,34 @@
                       : 0))
 #endif
 
+#ifndef CPPHTTPLIB_EVENT_LOOP_MAX_EVENTS
+#define CPPHTTPLIB_EVENT_LOOP_MAX_EVENTS 64
+#endif
+
+#ifndef CPPHTTPLIB_EVENT_LOOP_TICK_MSECOND
+#define CPPHTTPLIB_EVENT_LOOP_TICK_MSECOND 1000
+#endif
+
+#ifndef CPPHTTPLIB_BROTLI_QUALITY
+#define CPPHTTPLIB_BROTLI_QUALITY 5
+#endif
+
+#ifndef CPPHTTPLIB_BROTLI_STATIC_QUALITY
+#define CPPHTTPLIB_BROTLI_STATIC_QUALITY 6
+#endif
+
+#ifndef CPPHTTPLIB_GZIP_STATIC_LEVEL
+#define CPPHTTPLIB_GZIP_STATIC_LEVEL 6
+#endif
+
+#ifndef CPPHTTPLIB_IO_URING_BATCH
+#define CPPHTTPLIB_IO_URING_BATCH 8
+#endif
+
+#ifndef CPPHTTPLIB_IO_URING_PIPE_SIZE
+#define CPPHTTPLIB_IO_URING_PIPE_SIZE (1024 * 1024)
+#endif
+
 #ifndef CPPHTTPLIB_RECV_FLAGS
 #define CPPHTTPLIB_RECV_FLAGS 0
 #endif
@@ -182,6 +234,19 @@ using socket_t = SOCKET;
 #include <csignal>
 #include <pthread.h>
 #include <sys/select.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#ifdef CPPHTTPLIB_IO_URING_SUPPORT
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -215,6 +280,12 @@ using socket_t = int;
 #include <string>
 #include <sys/stat.h>
 #include <thread>
+#include <unordered_map>
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(CPPHTTPLIB_NO_SIMD)
+#define CPPHTTPLIB_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #ifdef CPPHTTPLIB_OPENSSL_SUPPORT
 // these are defined in wincrypt.h and it breaks compilation if BoringSSL is
@@ -297,12 +368,17 @@ struct ci {
   }
 };
 
+#ifdef __linux__
+class FileCache;
+#endif
+
 } // namespace detail
 
 using Headers = std::multimap<std::string, std::string, detail::ci>;
 
 using Params = std::multimap<std::string, std::string>;
 using Match = std::smatch;
+using PathParams = std::unordered_map<std::string, std::string>;
 
 using Progress = std::function<bool(uint64_t current, uint64_t total)>;
 
@@ -410,6 +486,7 @@ struct Request {
   MultipartFormDataMap files;
   Ranges ranges;
   Match matches;
+  PathParams path_params;
 
   // for client
   ResponseHandler response_handler;
@@ -494,6 +571,7 @@ struct Response {
   ContentProviderResourceReleaser content_provider_resource_releaser_;
   bool is_chunked_content_provider_ = false;
   bool content_provider_success_ = false;
+  int content_file_fd_ = -1;
 };
 
 class Stream {
@@ -508,6 +586,10 @@ public:
   virtual void get_remote_ip_and_port(std::string &ip, int &port) const = 0;
   virtual socket_t socket() const = 0;
 
+  // Sends `size` bytes of the file `fd` starting at `offset` without copying
+  // them through user space. Streams that can't do it fail with ENOSYS.
+  virtual ssize_t send_file(int fd, size_t offset, size_t size);
+
   template <typename... Args>
   ssize_t write_format(const char *fmt, const Args &...args);
   ssize_t write(const char *ptr);
@@ -601,6 +683,211 @@ using SocketOptions = std::function<void(socket_t sock)>;
 
 void default_socket_options(socket_t sock);
 
+// Counters of one of the server's pools. Object pools count objects,
+// buffer pools count bytes.
+struct PoolStats {
+  uint64_t acquires = 0; // handed out
+  uint64_t hits = 0;     // handed out from the pool instead of allocated
+  size_t in_use = 0;     // handed out and not returned yet
+  size_t peak_in_use = 0;
+  size_t cached = 0; // kept in the pool for reuse
+  size_t peak_cached = 0;
+};
+
+struct AllocatorStats {
+  PoolStats requests;  // Request objects of the server
+  PoolStats responses; // Response objects of the server
+  PoolStats buffers;   // receive buffers of connections and bodies
+};
+
+// Returns the counters of the pools shared by every server in the process.
+AllocatorStats allocator_stats();
+
+namespace detail {
+
+/*
+ * Request router. Patterns made of literal segments and named parameters,
+ * e.g. "/video/:id<int>", are compiled into a trie keyed by path segment, so
+ * a lookup costs one walk over the path no matter how many routes exist.
+ * A parameter is ":name" (any non-empty segment) or ":name<int>" (decimal
+ * digits that fit in an int); the values go to `req.path_params`.
+ * Any other pattern is treated as a std::regex like before and fills
+ * `req.matches`. Those are only tried, in registration order, when no trie
+ * route matches.
+ */
+template <typename T> class Router {
+public:
+  void add(const std::string &pattern, T handler) {
+    std::vector<std::string> names;
+    size_t node = 0;
+    if (!compile(pattern, node, names)) {
+      regexes_.emplace_back(std::regex(pattern), std::move(handler));
+      return;
+    }
+    // As with the regex list, the route registered first wins.
+    if (nodes_[node].route != npos) { return; }
+    nodes_[node].route = routes_.size();
+    routes_.emplace_back(std::move(names), std::move(handler));
+  }
+
+  const T *match(Request &req) const {
+    std::vector<std::pair<const char *, size_t>> values;
+    auto route = find(0, req.path.data(), req.path.data() + req.path.size(),
+                      values);
+    if (route != npos) {
+      const auto &names = routes_[route].first;
+      for (size_t i = 0; i < names.size(); i++) {
+        req.path_params[names[i]].assign(values[i].first, values[i].second);
+      }
+      return &routes_[route].second;
+    }
+    for (const auto &x : regexes_) {
+      if (std::regex_match(req.path, req.matches, x.first)) {
+        return &x.second;
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  struct Node {
+    // Literal child segments. Routes are few, so a linear scan is cheaper
+    // than hashing the segment.
+    std::vector<std::pair<std::string, size_t>> children;
+    size_t int_param = npos;
+    size_t str_param = npos;
+    size_t route = npos;
+  };
+
+  static bool is_regex_char(char c) {
+    return strchr("\\^$.|?*+()[]{}", c) != nullptr;
+  }
+
+  static bool is_int(const char *b, const char *e) {
+    auto len = static_cast<size_t>(e - b);
+    if (len == 0 || len > 10) { return false; }
+    for (auto p = b; p != e; p++) {
+      if (!isdigit(static_cast<unsigned char>(*p))) { return false; }
+    }
+    return len < 10 || std::string(b, len) <= std::to_string(INT_MAX);
+  }
+
+  size_t child(size_t node, size_t Node::*slot) {
+    if (nodes_[node].*slot == npos) {
+      nodes_.emplace_back();
+      nodes_[node].*slot = nodes_.size() - 1;
+    }
+    return nodes_[node].*slot;
+  }
+
+  // Returns false when the pattern has to be handled as a regex.
+  bool compile(const std::string &pattern, size_t &node,
+               std::vector<std::string> &names) {
+    if (nodes_.empty()) { nodes_.emplace_back(); }
+    std::vector<std::pair<int, std::string>> segments;
+    size_t beg = 0;
+    while (true) {
+      auto end = pattern.find('/', beg);
+      if (end == std::string::npos) { end = pattern.size(); }
+      auto seg = pattern.substr(beg, end - beg);
+      if (!seg.empty() && seg[0] == ':') {
+        auto type = 2;
+        auto name = seg.substr(1);
+        auto lt = name.find('<');
+        if (lt != std::string::npos) {
+          if (name.back() != '>') { return false; }
+          auto type_name = name.substr(lt + 1, name.size() - lt - 2);
+          if (type_name == "int") {
+            type = 1;
+          } else if (type_name != "string") {
+            throw std::invalid_argument("unknown path parameter type: " +
+                                        type_name);
+          }
+          name.resize(lt);
+        }
+        if (name.empty()) { return false; }
+        segments.emplace_back(type, std::move(name));
+      } else {
+        if (std::find_if(seg.begin(), seg.end(), is_regex_char) != seg.end()) {
+          return false;
+        }
+        segments.emplace_back(0, std::move(seg));
+      }
+      if (end == pattern.size()) { break; }
+      beg = end + 1;
+    }
+
+    node = 0;
+    for (auto &seg : segments) {
+      if (seg.first == 1) {
+        node = child(node, &Node::int_param);
+        names.push_back(std::move(seg.second));
+      } else if (seg.first == 2) {
+        node = child(node, &Node::str_param);
+        names.push_back(std::move(seg.second));
+      } else {
+        auto &children = nodes_[node].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [&](const std::pair<std::string, size_t> &x) {
+                                 return x.first == seg.second;
+                               });
+        if (it != children.end()) {
+          node = it->second;
+        } else {
+          nodes_.emplace_back();
+          nodes_[node].children.emplace_back(std::move(seg.second),
+                                             nodes_.size() - 1);
+          node = nodes_.size() - 1;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Literal segments take precedence over parameters, and int parameters
+  // over string ones; a dead end backtracks to the next candidate.
+  size_t find(size_t node, const char *b, const char *e,
+              std::vector<std::pair<const char *, size_t>> &values) const {
+    if (nodes_.empty()) { return npos; }
+    auto slash = static_cast<const char *>(memchr(b, '/', e - b));
+    auto seg_end = slash ? slash : e;
+    auto len = static_cast<size_t>(seg_end - b);
+    const auto &n = nodes_[node];
+
+    auto next = [&](size_t child) {
+      if (!slash) { return nodes_[child].route; }
+      return find(child, slash + 1, e, values);
+    };
+
+    for (const auto &x : n.children) {
+      if (x.first.size() == len && x.first.compare(0, len, b, len) == 0) {
+        auto route = next(x.second);
+        if (route != npos) { return route; }
+        break;
+      }
+    }
+    auto param = [&](size_t child) {
+      if (child == npos || len == 0) { return npos; }
+      values.emplace_back(b, len);
+      auto route = next(child);
+      if (route == npos) { values.pop_back(); }
+      return route;
+    };
+
+    auto route = is_int(b, seg_end) ? param(n.int_param) : npos;
+    if (route != npos) { return route; }
+    return param(n.str_param);
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<std::pair<std::vector<std::string>, T>> routes_;
+  std::vector<std::pair<std::regex, T>> regexes_;
+};
+
+} // namespace detail
+
 class Server {
 public:
   using Handler = std::function<void(const Request &, Response &)>;
@@ -645,7 +932,14 @@ public:
   bool remove_mount_point(const std::string &mount_point);
   Server &set_file_extension_and_mimetype_mapping(const char *ext,
                                                   const char *mime);
+  // Cache-Control sent with static files of the given extension. It takes
+  // precedence over a Cache-Control header given to set_mount_point().
+  Server &set_file_extension_and_cache_control_mapping(
+      const char *ext, const std::string &cache_control);
   Server &set_file_request_handler(Handler handler);
+  // Answers 404 for static files and directories whose name starts with a
+  // dot, e.g. scratch files written next to served ones. Off by default.
+  Server &set_dot_files_hidden(bool on);
 
   Server &set_error_handler(HandlerWithResponse handler);
   Server &set_error_handler(Handler handler);
@@ -679,6 +973,28 @@ public:
 
   Server &set_payload_max_length(size_t length);
 
+  // Serves keep-alive connections from an epoll event loop with the given
+  // number of I/O threads instead of parking a worker thread on each
+  // connection. 0 (the default) keeps the thread-per-connection model.
+  // Only available on Linux; ignored elsewhere and by SSLServer.
+  Server &set_event_loop(size_t io_thread_count);
+
+  // Keeps up to `max_entries` static files open, with their stat results,
+  // so that hot files under the mount points skip open() and fstat().
+  // Files of at most `max_file_size` bytes are served from memory instead,
+  // with gzip/brotli variants of compressible types built once and picked
+  // by Accept-Encoding; they may use up to `max_memory` bytes in total.
+  // Entries are invalidated through inotify. 0 (the default) disables it.
+  // Only available on Linux; ignored elsewhere.
+  Server &set_file_cache(size_t max_entries, size_t max_file_size = 0,
+                         size_t max_memory = 0);
+
+  // Keeps files below `dir` (a path under a mount point's base directory,
+  // e.g. "./www/uploads") out of the file cache and stops watching it, for
+  // directories whose files are written all the time.
+  Server &add_file_cache_exclusion(const std::string &dir);
+
+
   bool bind_to_port(const char *host, int port, int socket_flags = 0);
   int bind_to_any_port(const char *host, int socket_flags = 0);
   bool listen_after_bind();
@@ -705,11 +1021,15 @@ protected:
   time_t idle_interval_sec_ = CPPHTTPLIB_IDLE_INTERVAL_SECOND;
   time_t idle_interval_usec_ = CPPHTTPLIB_IDLE_INTERVAL_USECOND;
   size_t payload_max_length_ = CPPHTTPLIB_PAYLOAD_MAX_LENGTH;
+  size_t event_loop_thread_count_ = 0;
+  size_t file_cache_max_entries_ = 0;
+  size_t file_cache_max_file_size_ = 0;
+  size_t file_cache_max_memory_ = 0;
+  std::vector<std::string> file_cache_exclusions_;
 
 private:
-  using Handlers = std::vector<std::pair<std::regex, Handler>>;
-  using HandlersForContentReader =
-      std::vector<std::pair<std::regex, HandlerWithContentReader>>;
+  using Handlers = detail::Router<Handler>;
+  using HandlersForContentReader = detail::Router<HandlerWithContentReader>;
 
   socket_t create_server_socket(const char *host, int port, int socket_flags,
                                 SocketOptions socket_options) const;
@@ -717,7 +1037,7 @@ private:
   bool listen_internal();
 
   bool routing(Request &req, Response &res, Stream &strm);
-  bool handle_file_request(const Request &req, Response &res,
+  bool handle_file_request(Request &req, Response &res,
                            bool head = false);
   bool dispatch_request(Request &req, Response &res, const Handlers &handlers);
   bool
@@ -750,6 +1070,7 @@ private:
                          ContentReceiver multipart_receiver);
 
   virtual bool process_and_close_socket(socket_t sock);
+  virtual bool supports_event_loop() const;
 
   struct MountPointEntry {
     std::string mount_point;
@@ -757,10 +1078,15 @@ private:
     Headers headers;
   };
   std::vector<MountPointEntry> base_dirs_;
+#ifdef __linux__
+  std::shared_ptr<detail::FileCache> file_cache_;
+#endif
 
   std::atomic<bool> is_running_;
   std::map<std::string, std::string> file_extension_and_mimetype_map_;
+  std::map<std::string, std::string> file_extension_and_cache_control_map_;
   Handler file_request_handler_;
+  bool dot_files_hidden_ = false;
   Handlers get_handlers_;
   Handlers post_handlers_;
   HandlersForContentReader post_handlers_for_content_reader_;
@@ -1400,6 +1726,7 @@ public:
 
 private:
   bool process_and_close_socket(socket_t sock) override;
+  bool supports_event_loop() const override;
 
   SSL_CTX *ctx_;
   std::mutex ctx_mutex_;
@@ -1672,6 +1999,8 @@ make_basic_authentication_header(const std::string &username,
                                  const std::string &password,
                                  bool is_proxy = false);
 
+bool etag_matches(const Request &req, const std::string &etag);
+
 namespace detail {
 
 std::string encode_query_param(const std::string &value);
@@ -1716,6 +2045,10 @@ enum class EncodingType { None = 0, Gzip, Brotli };
 
 EncodingType encoding_type(const Request &req, const Response &res);
 
+bool accepts_encoding(const std::string &accept, const char *coding);
+
+bool can_compress_content_type(const std::string &content_type);
+
 class BufferStream : public Stream {
 public:
   BufferStream() = default;
@@ -2106,11 +2439,490 @@ inline void read_file(const std::string &path, std::string &out) {
   fs.read(&out[0], static_cast<std::streamsize>(size));
 }
 
+#ifndef _WIN32
+inline bool open_file(const std::string &path, int &fd, struct stat &st) {
+  fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return false; }
+
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  return true;
+}
+
+inline std::string make_file_etag(const struct stat &st) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx\"",
+           static_cast<unsigned long long>(st.st_ino),
+           static_cast<unsigned long long>(st.st_size),
+           static_cast<unsigned long long>(st.st_mtime));
+  return buf;
+}
+
+// An open regular file together with the validators derived from its stat.
+// Shared between the file cache and the responses streaming it; the
+// descriptor is closed when the last of them lets go.
+struct OpenFile {
+  int fd = -1;
+  struct stat st;
+  std::string etag;
+  std::string last_modified;
+  // Small files kept in memory by the file cache; the descriptor is closed
+  // once they are loaded. The compressed variants are only present when they
+  // are smaller than the original.
+  std::shared_ptr<const std::string> body;
+  std::shared_ptr<const std::string> gzip;
+  std::shared_ptr<const std::string> brotli;
+
+  size_t memory_size() const {
+    return (body ? body->size() : 0) + (gzip ? gzip->size() : 0) +
+           (brotli ? brotli->size() : 0);
+  }
+
+  OpenFile() = default;
+  OpenFile(const OpenFile &) = delete;
+  ~OpenFile() {
+    if (fd != -1) { ::close(fd); }
+  }
+};
+
+#endif
+
+inline std::string make_http_date(time_t t) {
+  struct tm tm;
+#ifdef _WIN32
+  gmtime_s(&tm, &t);
+#else
+  gmtime_r(&t, &tm);
+#endif
+  char buf[64];
+  strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return buf;
+}
+
+#ifndef _WIN32
+inline std::shared_ptr<OpenFile> open_file(const std::string &path) {
+  std::shared_ptr<OpenFile> file = std::make_shared<OpenFile>();
+  if (!open_file(path, file->fd, file->st)) { return nullptr; }
+  file->etag = make_file_etag(file->st);
+  file->last_modified = make_http_date(file->st.st_mtime);
+  return file;
+}
+
+inline ssize_t read_file_at(int fd, char *buf, size_t size, size_t offset) {
+  ssize_t res = 0;
+  while (true) {
+    res = pread(fd, buf, size, static_cast<off_t>(offset));
+    if (res < 0 && errno == EINTR) { continue; }
+    break;
+  }
+  return res;
+}
+
+inline ContentProvider make_file_content_provider(int fd) {
+  return [fd](size_t offset, size_t length, DataSink &sink) {
+    std::unique_ptr<char[]> buf(new char[CPPHTTPLIB_FILE_BUFSIZ]);
+    auto n = read_file_at(fd, buf.get(),
+                          (std::min)(length, CPPHTTPLIB_FILE_BUFSIZ), offset);
+    if (n <= 0) { return false; }
+    return sink.write(buf.get(), static_cast<size_t>(n));
+  };
+}
+#endif
+
+#ifdef __linux__
+// Recently served static files, keyed by path and evicted in LRU order, so
+// that a hot file costs a hash lookup instead of open() and fstat(). Files up
+// to `max_file_size` bytes are also read into memory, together with gzip and
+// brotli variants built at load time, within a budget of `max_memory` bytes.
+// Only one thread loads a given path; others asking for it meanwhile wait for
+// that result. Every directory below the mount points, except excluded ones,
+// is watched with inotify, and a change drops only the entries for the path
+// it concerns. Files under excluded directories (e.g. ones written all the
+// time) are neither watched nor cached. If the watch set cannot be kept
+// complete, the cache turns itself off.
+class FileCache {
+public:
+  FileCache(size_t max_entries, size_t max_file_size, size_t max_memory)
+      : max_entries_(max_entries), max_file_size_(max_file_size),
+        max_memory_(max_memory), enabled_(false), stopped_(false),
+        memory_(0) {}
+
+  FileCache(const FileCache &) = delete;
+
+  ~FileCache() {
+    stop();
+    if (inotify_fd_ >= 0) { ::close(inotify_fd_); }
+    if (wakefd_ >= 0) { ::close(wakefd_); }
+  }
+
+  bool start(const std::vector<std::string> &dirs,
+             const std::vector<std::string> &excluded) {
+    for (auto dir : excluded) {
+      while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+      }
+      excluded_.push_back(dir);
+    }
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakefd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (inotify_fd_ < 0 || wakefd_ < 0) { return false; }
+    for (const auto &dir : dirs) {
+      if (!watch_tree(dir)) { return false; }
+    }
+    enabled_ = true;
+    thread_ = std::thread([this]() { run(); });
+    return true;
+  }
+
+  void stop() {
+    if (!thread_.joinable()) { return; }
+    stopped_ = true;
+    uint64_t one = 1;
+    auto n = ::write(wakefd_, &one, sizeof(one));
+    (void)n;
+    thread_.join();
+  }
+
+  // Returns the file at `path`, from the cache when possible. Only pass
+  // canonical paths (no "." segments or doubled slashes); inotify reports
+  // changes under the canonical name only. `compress` asks for compressed
+  // variants when the file is loaded into memory.
+  std::shared_ptr<OpenFile> open(const std::string &path, bool compress) {
+    if (!enabled_ || is_excluded(path)) { return open_file(path); }
+
+    auto load = std::make_shared<Load>();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto it = entries_.find(path);
+      if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+      }
+      auto loading = loading_.find(path);
+      if (loading != loading_.end()) {
+        auto other = loading->second;
+        loaded_.wait(lock, [&]() { return other->done; });
+        if (!other->stale) { return other->file; }
+        // Changed while it was being read; open it again below, uncached.
+        lock.unlock();
+        return open_file(path);
+      }
+      loading_[path] = load;
+    }
+
+    auto file = open_file(path);
+    if (file && static_cast<size_t>(file->st.st_size) <= max_file_size_) {
+      read_into_memory(*file, compress);
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      loading_.erase(path);
+      load->file = file;
+      load->done = true;
+      // A change reported while the file was being read may not be in what
+      // was read; serve it, but don't cache what could already be stale.
+      if (file && !load->stale && enabled_) {
+        lru_.emplace_front(path, file);
+        entries_[path] = lru_.begin();
+        memory_ += file->memory_size();
+        while (entries_.size() > max_entries_ ||
+               (memory_ > max_memory_ && entries_.size() > 1)) {
+          erase(std::prev(lru_.end()));
+        }
+      }
+    }
+    loaded_.notify_all();
+    return file;
+  }
+
+private:
+  using Entry = std::pair<std::string, std::shared_ptr<OpenFile>>;
+
+  // A file being opened by one thread, shared with threads asking for the
+  // same path meanwhile.
+  struct Load {
+    bool done = false;
+    bool stale = false;
+    std::shared_ptr<OpenFile> file;
+  };
+
+  bool is_excluded(const std::string &path) const {
+    for (const auto &dir : excluded_) {
+      if (path.compare(0, dir.size(), dir) == 0 &&
+          (path.size() == dir.size() || path[dir.size()] == '/')) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Reads a small file into memory and builds its compressed variants.
+  // Leaves the file descriptor-backed if it changed size under us.
+  static void read_into_memory(OpenFile &file, bool compress) {
+    auto size = static_cast<size_t>(file.st.st_size);
+    std::string body(size, '\0');
+    size_t offset = 0;
+    while (offset < size) {
+      auto n = read_file_at(file.fd, &body[offset], size - offset, offset);
+      if (n <= 0) { return; }
+      offset += static_cast<size_t>(n);
+    }
+    ::close(file.fd);
+    file.fd = -1;
+
+    if (compress) {
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+      file.gzip = gzip_variant(body);
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+      file.brotli = brotli_variant(body);
+#endif
+    }
+    file.body = std::make_shared<const std::string>(std::move(body));
+  }
+
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+  // Compression runs on the request thread of the first miss, so the level
+  // trades a little size for a short stall.
+  static std::shared_ptr<const std::string>
+  gzip_variant(const std::string &data) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, CPPHTTPLIB_GZIP_STATIC_LEVEL, Z_DEFLATED, 31, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return nullptr;
+    }
+    std::string out(deflateBound(&strm, static_cast<uLong>(data.size())), '\0');
+    strm.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = static_cast<uInt>(data.size());
+    strm.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    strm.avail_out = static_cast<uInt>(out.size());
+    auto ret = deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+    if (ret != Z_STREAM_END || out.size() >= data.size()) { return nullptr; }
+    return std::make_shared<const std::string>(std::move(out));
+  }
+#endif
+
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+  static std::shared_ptr<const std::string>
+  brotli_variant(const std::string &data) {
+    auto size = BrotliEncoderMaxCompressedSize(data.size());
+    if (size == 0) { return nullptr; }
+    std::string out(size, '\0');
+    if (!BrotliEncoderCompress(CPPHTTPLIB_BROTLI_STATIC_QUALITY,
+                               BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               data.size(),
+                               reinterpret_cast<const uint8_t *>(data.data()),
+                               &size, reinterpret_cast<uint8_t *>(&out[0]))) {
+      return nullptr;
+    }
+    out.resize(size);
+    if (out.size() >= data.size()) { return nullptr; }
+    return std::make_shared<const std::string>(std::move(out));
+  }
+#endif
+
+  // Removes one entry; the caller holds `mutex_`.
+  void erase(std::list<Entry>::iterator it) {
+    memory_ -= it->second->memory_size();
+    entries_.erase(it->first);
+    lru_.erase(it);
+  }
+
+  static const uint32_t watch_mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                     IN_MOVED_TO | IN_DELETE_SELF |
+                                     IN_MOVE_SELF | IN_ONLYDIR;
+
+  // Adds watches for `dir` and every directory below it. Only touched by
+  // start() and then by the inotify thread, so `watches_` needs no lock.
+  bool watch_tree(const std::string &dir) {
+    if (is_excluded(dir)) { return true; }
+    auto wd = inotify_add_watch(inotify_fd_, dir.c_str(), watch_mask);
+    if (wd < 0) { return errno == ENOENT || errno == ENOTDIR; }
+    auto &paths = watches_[wd];
+    if (std::find(paths.begin(), paths.end(), dir) == paths.end()) {
+      paths.push_back(dir);
+    }
+
+    auto d = opendir(dir.c_str());
+    if (!d) { return true; }
+    auto ok = true;
+    while (auto ent = readdir(d)) {
+      if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
+        continue;
+      }
+      auto sub = dir + "/" + ent->d_name;
+      if (ent->d_type == DT_DIR ||
+          (ent->d_type == DT_UNKNOWN && is_dir(sub))) {
+        if (!watch_tree(sub)) {
+          ok = false;
+          break;
+        }
+      }
+    }
+    closedir(d);
+    return ok;
+  }
+
+  // Stops watching `dir` and everything below it under that name, after it
+  // was moved away; the watches follow the directory, so its events would
+  // otherwise be reported under the old name.
+  void forget_tree(const std::string &dir) {
+    for (auto it = watches_.begin(); it != watches_.end();) {
+      auto &paths = it->second;
+      paths.erase(std::remove_if(paths.begin(), paths.end(),
+                                 [&](const std::string &path) {
+                                   return is_below(path, dir);
+                                 }),
+                  paths.end());
+      if (paths.empty()) {
+        inotify_rm_watch(inotify_fd_, it->first);
+        it = watches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  static bool is_below(const std::string &path, const std::string &dir) {
+    return path.compare(0, dir.size(), dir) == 0 &&
+           (path.size() == dir.size() || path[dir.size()] == '/');
+  }
+
+  void run() {
+    pollfd fds[2];
+    fds[0].fd = inotify_fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakefd_;
+    fds[1].events = POLLIN;
+    alignas(inotify_event) char buf[4096];
+
+    while (!stopped_) {
+      if (poll(fds, 2, -1) < 0 && errno != EINTR) { break; }
+      while (true) {
+        auto n = ::read(inotify_fd_, buf, sizeof(buf));
+        if (n <= 0) { break; }
+        for (auto p = buf; p < buf + n;) {
+          auto ev = reinterpret_cast<const inotify_event *>(p);
+          handle_event(*ev);
+          p += sizeof(inotify_event) + ev->len;
+        }
+      }
+    }
+  }
+
+  void handle_event(const inotify_event &ev) {
+    if (ev.mask & IN_Q_OVERFLOW) {
+      invalidate_all();
+      return;
+    }
+    auto it = watches_.find(ev.wd);
+    if (it == watches_.end()) { return; }
+    auto paths = it->second;
+
+    // A watched directory went away. If it was moved, the move is normally
+    // handled by its parent's IN_MOVED_FROM; a mount point has no watched
+    // parent, so drop whichever of its names no longer exists.
+    if (ev.mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+      if (ev.mask & IN_IGNORED) { watches_.erase(it); }
+      for (const auto &dir : paths) {
+        if ((ev.mask & IN_MOVE_SELF) && is_dir(dir)) { continue; }
+        if (ev.mask & IN_MOVE_SELF) { forget_tree(dir); }
+        invalidate(dir, true);
+      }
+      return;
+    }
+    if (ev.len == 0) { return; }
+
+    for (const auto &dir : paths) {
+      auto path = dir + "/" + ev.name;
+      if (!(ev.mask & IN_ISDIR)) {
+        invalidate(path, false);
+        continue;
+      }
+      // Files below a directory change their names when it is moved.
+      if (ev.mask & IN_MOVED_FROM) { forget_tree(path); }
+      if ((ev.mask & (IN_CREATE | IN_MOVED_TO)) && !watch_tree(path)) {
+        disable();
+        return;
+      }
+      invalidate(path, true);
+    }
+  }
+
+  // Drops the entry for `path`, or with `tree` everything below it, and
+  // keeps loads still in progress for them out of the cache.
+  void invalidate(const std::string &path, bool tree) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!tree) {
+      auto entry = entries_.find(path);
+      if (entry != entries_.end()) { erase(entry->second); }
+      auto loading = loading_.find(path);
+      if (loading != loading_.end()) { loading->second->stale = true; }
+      return;
+    }
+    for (auto it = lru_.begin(); it != lru_.end();) {
+      auto next = std::next(it);
+      if (is_below(it->first, path)) { erase(it); }
+      it = next;
+    }
+    for (auto &loading : loading_) {
+      if (is_below(loading.first, path)) { loading.second->stale = true; }
+    }
+  }
+
+  void invalidate_all() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    entries_.clear();
+    lru_.clear();
+    memory_ = 0;
+    for (auto &loading : loading_) {
+      loading.second->stale = true;
+    }
+  }
+
+  void disable() {
+    enabled_ = false;
+    invalidate_all();
+  }
+
+  size_t max_entries_;
+  size_t max_file_size_;
+  size_t max_memory_;
+  std::vector<std::string> excluded_;
+  std::atomic<bool> enabled_;
+  int inotify_fd_ = -1;
+  int wakefd_ = -1;
+  std::thread thread_;
+  std::atomic<bool> stopped_;
+  std::map<int, std::vector<std::string>> watches_;
+
+  std::mutex mutex_;
+  std::condition_variable loaded_;
+  size_t memory_;
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  std::unordered_map<std::string, std::shared_ptr<Load>> loading_;
+};
+#endif
+
 inline std::string file_extension(const std::string &path) {
-  std::smatch m;
-  static auto re = std::regex("\\.([a-zA-Z0-9]+)$");
-  if (std::regex_search(path, m, re)) { return m[1].str(); }
-  return std::string();
+  auto pos = path.rfind('.');
+  if (pos == std::string::npos || pos + 1 == path.size()) {
+    return std::string();
+  }
+  for (auto i = pos + 1; i < path.size(); i++) {
+    if (!isalnum(static_cast<unsigned char>(path[i]))) { return std::string(); }
+  }
+  return path.substr(pos + 1);
 }
 
 inline bool is_space_or_tab(char c) { return c == ' ' || c == '\t'; }
@@ -2395,6 +3207,13 @@ public:
   ssize_t write(const char *ptr, size_t size) override;
   void get_remote_ip_and_port(std::string &ip, int &port) const override;
   socket_t socket() const override;
+  ssize_t send_file(int fd, size_t offset, size_t size) override;
+
+  // Whether bytes already read from the socket are waiting to be consumed.
+  bool has_buffered_data() const;
+  // Returns the read buffer to the pool when it holds nothing, so an idle
+  // keep-alive connection does not keep one.
+  void release_read_buffer();
 
 private:
   socket_t sock_;
@@ -2403,7 +3222,8 @@ private:
   time_t write_timeout_sec_;
   time_t write_timeout_usec_;
 
-  std::vector<char> read_buff_;
+  // Taken from the receive buffer pool on the first small read.
+  char *read_buff_ = nullptr;
   size_t read_buff_off_ = 0;
   size_t read_buff_content_size_ = 0;
 
@@ -2454,16 +3274,19 @@ inline bool keep_alive(socket_t sock, time_t keep_alive_timeout_sec) {
   }
 }
 
-template <typename T>
+// `pending` tells whether the stream already holds bytes of the next request,
+// in which case there is nothing to wait for on the socket.
+template <typename T, typename U>
 inline bool
 process_server_socket_core(const std::atomic<socket_t> &svr_sock, socket_t sock,
                            size_t keep_alive_max_count,
-                           time_t keep_alive_timeout_sec, T callback) {
+                           time_t keep_alive_timeout_sec, T callback,
+                           U pending) {
   assert(keep_alive_max_count > 0);
   auto ret = false;
   auto count = keep_alive_max_count;
   while (svr_sock != INVALID_SOCKET && count > 0 &&
-         keep_alive(sock, keep_alive_timeout_sec)) {
+         (pending() || keep_alive(sock, keep_alive_timeout_sec))) {
     auto close_connection = count == 1;
     auto connection_closed = false;
     ret = callback(close_connection, connection_closed);
@@ -2480,13 +3303,16 @@ process_server_socket(const std::atomic<socket_t> &svr_sock, socket_t sock,
                       time_t keep_alive_timeout_sec, time_t read_timeout_sec,
                       time_t read_timeout_usec, time_t write_timeout_sec,
                       time_t write_timeout_usec, T callback) {
+  // One stream for the whole connection: what it has read past the end of a
+  // request is the start of the next, pipelined one.
+  SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
+                    write_timeout_sec, write_timeout_usec);
   return process_server_socket_core(
       svr_sock, sock, keep_alive_max_count, keep_alive_timeout_sec,
       [&](bool close_connection, bool &connection_closed) {
-        SocketStream strm(sock, read_timeout_sec, read_timeout_usec,
-                          write_timeout_sec, write_timeout_usec);
         return callback(strm, close_connection, connection_closed);
-      });
+      },
+      [&]() { return strm.has_buffered_data(); });
 }
 
 inline bool process_client_socket(socket_t sock, time_t read_timeout_sec,
@@ -2507,6 +3333,254 @@ inline int shutdown_socket(socket_t sock) {
 #endif
 }
 
+#ifdef __linux__
+// Edge-triggered epoll reactor for server connections. A few I/O threads
+// watch the keep-alive connections; a connection is handed to the task queue
+// only when a request has started to arrive, and is re-armed (EPOLLONESHOT)
+// after that request has been answered. Idle connections therefore cost no
+// worker thread while they wait. Each connection keeps one SocketStream, so
+// bytes read past the end of a request (pipelining) are served next instead
+// of being lost.
+class EventLoop {
+public:
+  using Processor = std::function<bool(Stream &strm, bool close_connection,
+                                       bool &connection_closed)>;
+
+  EventLoop(size_t thread_count, TaskQueue &task_queue,
+            size_t keep_alive_max_count, time_t keep_alive_timeout_sec,
+            time_t read_timeout_sec, time_t read_timeout_usec,
+            time_t write_timeout_sec, time_t write_timeout_usec,
+            Processor processor)
+      : thread_count_(thread_count ? thread_count : 1),
+        task_queue_(task_queue), keep_alive_max_count_(keep_alive_max_count),
+        keep_alive_timeout_sec_(keep_alive_timeout_sec),
+        read_timeout_sec_(read_timeout_sec),
+        read_timeout_usec_(read_timeout_usec),
+        write_timeout_sec_(write_timeout_sec),
+        write_timeout_usec_(write_timeout_usec),
+        processor_(std::move(processor)), stopped_(false), next_(0) {}
+
+  EventLoop(const EventLoop &) = delete;
+
+  ~EventLoop() {
+    stop();
+    close_all();
+  }
+
+  bool start() {
+    for (size_t i = 0; i < thread_count_; i++) {
+      std::unique_ptr<Poller> poller(new Poller());
+      poller->epfd = epoll_create1(EPOLL_CLOEXEC);
+      poller->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (poller->epfd < 0 || poller->wakefd < 0) {
+        if (poller->epfd >= 0) { ::close(poller->epfd); }
+        if (poller->wakefd >= 0) { ::close(poller->wakefd); }
+        stop();
+        return false;
+      }
+      epoll_event ev;
+      ev.events = EPOLLIN;
+      ev.data.fd = poller->wakefd;
+      epoll_ctl(poller->epfd, EPOLL_CTL_ADD, poller->wakefd, &ev);
+      pollers_.push_back(std::move(poller));
+    }
+    for (auto &poller : pollers_) {
+      auto p = poller.get();
+      p->thread = std::thread([this, p]() { run(*p); });
+    }
+    return true;
+  }
+
+  // Registers an accepted connection with one of the I/O threads.
+  void add(socket_t sock) {
+    auto &p = *pollers_[next_++ % pollers_.size()];
+    {
+      std::lock_guard<std::mutex> guard(p.mutex);
+      auto &conn = p.conns[sock];
+      conn.remaining = keep_alive_max_count_;
+      conn.last_active = std::chrono::steady_clock::now();
+      conn.busy = false;
+      conn.strm.reset(new SocketStream(sock, read_timeout_sec_,
+                                       read_timeout_usec_, write_timeout_sec_,
+                                       write_timeout_usec_));
+    }
+    if (!arm(p, sock, EPOLL_CTL_ADD)) { close_connection(p, sock); }
+  }
+
+  // Stops the I/O threads. Requests already handed to the task queue keep
+  // running; their connections are closed by close_all().
+  void stop() {
+    if (stopped_.exchange(true)) { return; }
+    for (auto &poller : pollers_) {
+      uint64_t one = 1;
+      auto n = ::write(poller->wakefd, &one, sizeof(one));
+      (void)n;
+    }
+    for (auto &poller : pollers_) {
+      if (poller->thread.joinable()) { poller->thread.join(); }
+    }
+  }
+
+  // Closes every remaining connection. Call after the task queue is shut
+  // down so that no request is still using them.
+  void close_all() {
+    for (auto &poller : pollers_) {
+      for (auto &conn : poller->conns) {
+        shutdown_socket(conn.first);
+        close_socket(conn.first);
+      }
+      poller->conns.clear();
+      if (poller->epfd >= 0) { ::close(poller->epfd); }
+      if (poller->wakefd >= 0) { ::close(poller->wakefd); }
+      poller->epfd = poller->wakefd = -1;
+    }
+    pollers_.clear();
+  }
+
+private:
+  struct Connection {
+    size_t remaining;
+    std::chrono::steady_clock::time_point last_active;
+    bool busy;
+    std::unique_ptr<SocketStream> strm;
+  };
+
+  struct Poller {
+    int epfd = -1;
+    int wakefd = -1;
+    std::thread thread;
+    std::mutex mutex;
+    std::map<socket_t, Connection> conns;
+  };
+
+  bool arm(Poller &p, socket_t sock, int op) {
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    ev.data.fd = sock;
+    return epoll_ctl(p.epfd, op, sock, &ev) == 0;
+  }
+
+  void close_connection(Poller &p, socket_t sock) {
+    {
+      std::lock_guard<std::mutex> guard(p.mutex);
+      p.conns.erase(sock);
+    }
+    epoll_ctl(p.epfd, EPOLL_CTL_DEL, sock, nullptr);
+    shutdown_socket(sock);
+    close_socket(sock);
+  }
+
+  void run(Poller &p) {
+    epoll_event events[CPPHTTPLIB_EVENT_LOOP_MAX_EVENTS];
+    auto last_sweep = std::chrono::steady_clock::now();
+    while (!stopped_) {
+      auto n = epoll_wait(p.epfd, events, CPPHTTPLIB_EVENT_LOOP_MAX_EVENTS,
+                          CPPHTTPLIB_EVENT_LOOP_TICK_MSECOND);
+      if (n < 0 && errno != EINTR) { break; }
+
+      for (int i = 0; i < n; i++) {
+        auto sock = events[i].data.fd;
+        if (sock == p.wakefd) { continue; }
+
+        auto flags = events[i].events;
+        if ((flags & (EPOLLHUP | EPOLLERR)) && !(flags & EPOLLIN)) {
+          close_connection(p, sock);
+          continue;
+        }
+
+        {
+          std::lock_guard<std::mutex> guard(p.mutex);
+          auto it = p.conns.find(sock);
+          if (it == p.conns.end()) { continue; }
+          it->second.busy = true;
+        }
+        auto pp = &p;
+        task_queue_.enqueue([this, pp, sock]() { serve(*pp, sock); });
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_sweep >=
+          std::chrono::milliseconds(CPPHTTPLIB_EVENT_LOOP_TICK_MSECOND)) {
+        sweep(p, now);
+        last_sweep = now;
+      }
+    }
+  }
+
+  // Runs the requests that have arrived on a worker thread, then either
+  // re-arms the connection for the next request or closes it. A busy
+  // connection is neither swept nor armed, so its stream stays valid here.
+  void serve(Poller &p, socket_t sock) {
+    size_t remaining = 0;
+    SocketStream *strm = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(p.mutex);
+      auto it = p.conns.find(sock);
+      if (it == p.conns.end()) { return; }
+      remaining = it->second.remaining;
+      strm = it->second.strm.get();
+    }
+
+    while (true) {
+      auto close_connection_after = remaining <= 1;
+      auto connection_closed = false;
+      auto ret = processor_(*strm, close_connection_after, connection_closed);
+
+      if (!ret || connection_closed || close_connection_after || stopped_) {
+        if (!stopped_) { close_connection(p, sock); }
+        return;
+      }
+      remaining--;
+
+      // With edge-triggered epoll, bytes the stream already holds raise no
+      // new event, so a pipelined request is served right away.
+      if (!strm->has_buffered_data()) { break; }
+    }
+
+    strm->release_read_buffer();
+    {
+      std::lock_guard<std::mutex> guard(p.mutex);
+      auto &conn = p.conns[sock];
+      conn.remaining = remaining;
+      conn.last_active = std::chrono::steady_clock::now();
+      conn.busy = false;
+    }
+    if (!arm(p, sock, EPOLL_CTL_MOD)) { close_connection(p, sock); }
+  }
+
+  // Closes keep-alive connections that stayed idle longer than the timeout.
+  void sweep(Poller &p, std::chrono::steady_clock::time_point now) {
+    std::vector<socket_t> expired;
+    {
+      std::lock_guard<std::mutex> guard(p.mutex);
+      for (auto &conn : p.conns) {
+        if (!conn.second.busy &&
+            now - conn.second.last_active >
+                std::chrono::seconds(keep_alive_timeout_sec_)) {
+          expired.push_back(conn.first);
+        }
+      }
+    }
+    for (auto sock : expired) {
+      close_connection(p, sock);
+    }
+  }
+
+  size_t thread_count_;
+  TaskQueue &task_queue_;
+  size_t keep_alive_max_count_;
+  time_t keep_alive_timeout_sec_;
+  time_t read_timeout_sec_;
+  time_t read_timeout_usec_;
+  time_t write_timeout_sec_;
+  time_t write_timeout_usec_;
+  Processor processor_;
+  std::atomic<bool> stopped_;
+  std::atomic<size_t> next_;
+  std::vector<std::unique_ptr<Poller>> pollers_;
+};
+#endif
+
 template <typename BindOrConnect>
 socket_t create_socket(const char *host, const char *ip, int port,
                        int address_family, int socket_flags, bool tcp_nodelay,
@@ -2952,20 +4026,49 @@ inline EncodingType encoding_type(const Request &req, const Response &res) {
   (void)(s);
 
 #ifdef CPPHTTPLIB_BROTLI_SUPPORT
-  // TODO: 'Accept-Encoding' has br, not br;q=0
-  ret = s.find("br") != std::string::npos;
-  if (ret) { return EncodingType::Brotli; }
+  if (accepts_encoding(s, "br")) { return EncodingType::Brotli; }
 #endif
 
 #ifdef CPPHTTPLIB_ZLIB_SUPPORT
-  // TODO: 'Accept-Encoding' has gzip, not gzip;q=0
-  ret = s.find("gzip") != std::string::npos;
-  if (ret) { return EncodingType::Gzip; }
+  if (accepts_encoding(s, "gzip")) { return EncodingType::Gzip; }
 #endif
 
   return EncodingType::None;
 }
 
+// Whether an Accept-Encoding value allows `coding`. An explicit entry wins
+// over "*", and a q-value of 0 refuses the coding.
+inline bool accepts_encoding(const std::string &accept, const char *coding) {
+  auto len = strlen(coding);
+  auto listed = -1;
+  auto wildcard = -1;
+  split(accept.data(), accept.data() + accept.size(), ',',
+        [&](const char *b, const char *e) {
+          auto semi = std::find(b, e, ';');
+          auto r = trim(b, semi, 0, static_cast<size_t>(semi - b));
+          auto name = b + r.first;
+          auto name_len = r.second - r.first;
+
+          auto allowed = 1;
+          auto q = std::string(semi, e).find("q=");
+          if (q != std::string::npos) {
+            allowed = std::atof(std::string(semi + q + 2, e).c_str()) > 0;
+          }
+
+          if (name_len == 1 && *name == '*') {
+            wildcard = allowed;
+          } else if (name_len == len &&
+                     std::equal(name, name + len, coding,
+                                [](char a, char b) {
+                                  return ::tolower(a) == ::tolower(b);
+                                })) {
+            listed = allowed;
+          }
+        });
+  if (listed != -1) { return listed == 1; }
+  return wildcard == 1;
+}
+
 inline bool nocompressor::compress(const char *data, size_t data_length,
                                    bool /*last*/, Callback callback) {
   if (!data_length) { return true; }
@@ -3093,6 +4196,10 @@ inline bool gzip_decompressor::decompress(const char *data, size_t data_length,
 #ifdef CPPHTTPLIB_BROTLI_SUPPORT
 inline brotli_compressor::brotli_compressor() {
   state_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+  // The library default (11) is meant for offline use and is far too slow
+  // to run on every response.
+  BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY,
+                            CPPHTTPLIB_BROTLI_QUALITY);
 }
 
 inline brotli_compressor::~brotli_compressor() {
@@ -3258,23 +4365,303 @@ inline bool read_headers(Stream &strm, Headers &headers) {
   return true;
 }
 
+// Counters behind PoolStats, updated by any thread without a lock.
+class pool_counters {
+public:
+  void acquired(size_t amount, bool hit) {
+    acquires_++;
+    if (hit) {
+      hits_++;
+      cached_ -= amount;
+    }
+    raise(peak_in_use_, in_use_ += amount);
+  }
+
+  void released(size_t amount, bool cached) {
+    in_use_ -= amount;
+    if (cached) { raise(peak_cached_, cached_ += amount); }
+  }
+
+  void dropped(size_t amount) { cached_ -= amount; }
+
+  PoolStats snapshot() const {
+    PoolStats stats;
+    stats.acquires = acquires_;
+    stats.hits = hits_;
+    stats.in_use = in_use_;
+    stats.peak_in_use = peak_in_use_;
+    stats.cached = cached_;
+    stats.peak_cached = peak_cached_;
+    return stats;
+  }
+
+private:
+  static void raise(std::atomic<size_t> &peak, size_t value) {
+    auto current = peak.load();
+    while (value > current && !peak.compare_exchange_weak(current, value)) {}
+  }
+
+  std::atomic<uint64_t> acquires_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<size_t> in_use_{0};
+  std::atomic<size_t> peak_in_use_{0};
+  std::atomic<size_t> cached_{0};
+  std::atomic<size_t> peak_cached_{0};
+};
+
+// Receive buffers in power-of-two size classes from CPPHTTPLIB_RECV_BUFSIZ
+// to CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ. Each thread keeps freed buffers, up to
+// CPPHTTPLIB_THREAD_BUFFER_CACHE_MAX bytes, in a cache of its own that needs
+// no lock; the rest go to a shared list of at most
+// CPPHTTPLIB_RECV_BUFFER_POOL_MAX bytes, and anything beyond that is freed.
+// Other sizes are not pooled.
+class buffer_pool {
+public:
+  static const size_t class_count = 16;
+
+  static buffer_pool &instance() {
+    // Never destroyed, so threads still reading at exit do not touch a dead
+    // pool.
+    static auto pool = new buffer_pool();
+    return *pool;
+  }
+
+  char *acquire(size_t size) {
+    auto c = size_class(size);
+    if (c < class_count) {
+      auto &cache = local().buffers[c];
+      if (!cache.empty()) {
+        auto buf = cache.back();
+        cache.pop_back();
+        local().bytes -= size;
+        counters_.acquired(size, true);
+        return buf;
+      }
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!shared_[c].empty()) {
+        auto buf = shared_[c].back();
+        shared_[c].pop_back();
+        shared_bytes_ -= size;
+        counters_.acquired(size, true);
+        return buf;
+      }
+    }
+    counters_.acquired(size, false);
+    return new char[size];
+  }
+
+  void release(char *buf, size_t size) {
+    auto c = size_class(size);
+    if (c < class_count) {
+      auto &cache = local();
+      if (cache.bytes + size <= CPPHTTPLIB_THREAD_BUFFER_CACHE_MAX) {
+        cache.buffers[c].push_back(buf);
+        cache.bytes += size;
+        counters_.released(size, true);
+        return;
+      }
+      if (keep(buf, c)) {
+        counters_.released(size, true);
+        return;
+      }
+    }
+    counters_.released(size, false);
+    delete[] buf;
+  }
+
+  PoolStats stats() const { return counters_.snapshot(); }
+
+private:
+  struct thread_cache {
+    std::vector<char *> buffers[class_count];
+    size_t bytes = 0;
+
+    ~thread_cache() {
+      auto &pool = instance();
+      for (size_t c = 0; c < class_count; c++) {
+        for (auto buf : buffers[c]) {
+          if (!pool.keep(buf, c)) {
+            pool.counters_.dropped(class_size(c));
+            delete[] buf;
+          }
+        }
+      }
+    }
+  };
+
+  static size_t class_size(size_t c) { return CPPHTTPLIB_RECV_BUFSIZ << c; }
+
+  // Index of the class of exactly `size` bytes, or class_count.
+  static size_t size_class(size_t size) {
+    for (size_t c = 0; c < class_count; c++) {
+      auto n = class_size(c);
+      if (n > CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ || n > size) { break; }
+      if (n == size) { return c; }
+    }
+    return class_count;
+  }
+
+  static thread_cache &local() {
+    static thread_local thread_cache cache;
+    return cache;
+  }
+
+  bool keep(char *buf, size_t c) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (shared_bytes_ + class_size(c) > CPPHTTPLIB_RECV_BUFFER_POOL_MAX) {
+      return false;
+    }
+    shared_[c].push_back(buf);
+    shared_bytes_ += class_size(c);
+    return true;
+  }
+
+  std::mutex mutex_;
+  std::vector<char *> shared_[class_count];
+  size_t shared_bytes_ = 0;
+  pool_counters counters_;
+};
+
+// Request and Response objects kept per thread, so that a keep-alive
+// connection reuses the body storage of the previous request instead of
+// growing a fresh string every time. A returned object is reset to its
+// default state; bodies up to CPPHTTPLIB_POOLED_BODY_CAPACITY_MAX keep their
+// capacity, larger ones are freed.
+inline void keep_body(std::string &body, std::string &kept) {
+  body.clear();
+  if (body.capacity() <= CPPHTTPLIB_POOLED_BODY_CAPACITY_MAX) {
+    body.swap(kept);
+  }
+}
+
+inline void reset_object(Request &req) {
+  std::string body;
+  body.swap(req.body);
+  req = Request();
+  keep_body(body, req.body);
+}
+
+inline void reset_object(Response &res) {
+  if (res.content_provider_resource_releaser_) {
+    res.content_provider_resource_releaser_(res.content_provider_success_);
+    res.content_provider_resource_releaser_ = nullptr;
+  }
+  std::string body;
+  body.swap(res.body);
+  res = Response();
+  keep_body(body, res.body);
+}
+
+template <typename T> class object_pool {
+public:
+  struct deleter {
+    void operator()(T *obj) const { release(obj); }
+  };
+
+  using pointer = std::unique_ptr<T, deleter>;
+
+  static pointer acquire() {
+    auto &objs = local().objs;
+    if (!objs.empty()) {
+      auto obj = objs.back();
+      objs.pop_back();
+      counters().acquired(1, true);
+      return pointer(obj);
+    }
+    counters().acquired(1, false);
+    return pointer(new T());
+  }
+
+  static pool_counters &counters() {
+    static auto counters = new pool_counters();
+    return *counters;
+  }
+
+private:
+  struct thread_cache {
+    std::vector<T *> objs;
+
+    ~thread_cache() {
+      for (auto obj : objs) {
+        counters().dropped(1);
+        delete obj;
+      }
+    }
+  };
+
+  static thread_cache &local() {
+    static thread_local thread_cache cache;
+    return cache;
+  }
+
+  static void release(T *obj) {
+    auto &objs = local().objs;
+    if (objs.size() < CPPHTTPLIB_OBJECT_POOL_SIZE) {
+      reset_object(*obj);
+      objs.push_back(obj);
+      counters().released(1, true);
+      return;
+    }
+    counters().released(1, false);
+    delete obj;
+  }
+};
+
+// Receive buffer for a body. It starts on the stack with
+// CPPHTTPLIB_RECV_BUFSIZ bytes and, each time a read fills it while more of
+// the body is expected, moves to a pooled buffer of twice the size, up to
+// CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ. Small bodies never leave the stack; large
+// uploads quickly get down to one recv per megabyte.
+class recv_body_buffer {
+public:
+  recv_body_buffer() = default;
+  recv_body_buffer(const recv_body_buffer &) = delete;
+  recv_body_buffer &operator=(const recv_body_buffer &) = delete;
+
+  ~recv_body_buffer() {
+    if (heap_) { buffer_pool::instance().release(heap_, size_); }
+  }
+
+  char *data() { return heap_ ? heap_ : stack_; }
+  size_t size() const { return size_; }
+
+  void adapt(size_t last_read, uint64_t remaining) {
+    if (last_read < size_ || size_ >= CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ ||
+        remaining <= size_) {
+      return;
+    }
+    auto size = (std::min)(size_ * 2, CPPHTTPLIB_RECV_BODY_MAX_BUFSIZ);
+    auto buf = buffer_pool::instance().acquire(size);
+    if (heap_) { buffer_pool::instance().release(heap_, size_); }
+    heap_ = buf;
+    size_ = size;
+  }
+
+private:
+  char stack_[CPPHTTPLIB_RECV_BUFSIZ];
+  char *heap_ = nullptr;
+  size_t size_ = CPPHTTPLIB_RECV_BUFSIZ;
+};
+
 inline bool read_content_with_length(Stream &strm, uint64_t len,
                                      Progress progress,
                                      ContentReceiverWithProgress out) {
-  char buf[CPPHTTPLIB_RECV_BUFSIZ];
+  recv_body_buffer buf;
 
   uint64_t r = 0;
   while (r < len) {
     auto read_len = static_cast<size_t>(len - r);
-    auto n = strm.read(buf, (std::min)(read_len, CPPHTTPLIB_RECV_BUFSIZ));
+    auto n = strm.read(buf.data(), (std::min)(read_len, buf.size()));
     if (n <= 0) { return false; }
 
-    if (!out(buf, static_cast<size_t>(n), r, len)) { return false; }
+    if (!out(buf.data(), static_cast<size_t>(n), r, len)) { return false; }
     r += static_cast<uint64_t>(n);
 
     if (progress) {
       if (!progress(r, len)) { return false; }
     }
+
+    buf.adapt(static_cast<size_t>(n), len - r);
   }
 
   return true;
@@ -3293,18 +4680,19 @@ inline void skip_content_with_length(Stream &strm, uint64_t len) {
 
 inline bool read_content_without_length(Stream &strm,
                                         ContentReceiverWithProgress out) {
-  char buf[CPPHTTPLIB_RECV_BUFSIZ];
+  recv_body_buffer buf;
   uint64_t r = 0;
   for (;;) {
-    auto n = strm.read(buf, CPPHTTPLIB_RECV_BUFSIZ);
+    auto n = strm.read(buf.data(), buf.size());
     if (n < 0) {
       return false;
     } else if (n == 0) {
       return true;
     }
 
-    if (!out(buf, static_cast<size_t>(n), r, 0)) { return false; }
+    if (!out(buf.data(), static_cast<size_t>(n), r, 0)) { return false; }
     r += static_cast<uint64_t>(n);
+    buf.adapt(static_cast<size_t>(n), (std::numeric_limits<uint64_t>::max)());
   }
 
   return true;
@@ -3502,6 +4890,44 @@ inline bool write_content(Stream &strm, const ContentProvider &content_provider,
                        error);
 }
 
+template <typename T>
+inline bool write_file_content(Stream &strm, int fd,
+                               const ContentProvider &content_provider,
+                               size_t offset, size_t length,
+                               const T &is_shutting_down) {
+  size_t end_offset = offset + length;
+  while (offset < end_offset && !is_shutting_down()) {
+    auto n = strm.send_file(fd, offset, end_offset - offset);
+    if (n < 0) {
+      // Zero-copy isn't available for this stream, so fall back to the
+      // buffered content provider for the rest of the range.
+      if (errno == ENOSYS || errno == EINVAL) { break; }
+      return false;
+    }
+    if (n == 0) { return false; } // The file was truncated under us
+    offset += static_cast<size_t>(n);
+  }
+
+  if (offset < end_offset && !is_shutting_down()) {
+    return write_content(strm, content_provider, offset, end_offset - offset,
+                         is_shutting_down);
+  }
+  return true;
+}
+
+template <typename T>
+inline bool write_response_content(Stream &strm, const Response &res,
+                                   size_t offset, size_t length,
+                                   const T &is_shutting_down) {
+  if (res.content_file_fd_ != -1) {
+    return write_file_content(strm, res.content_file_fd_,
+                              res.content_provider_, offset, length,
+                              is_shutting_down);
+  }
+  return write_content(strm, res.content_provider_, offset, length,
+                       is_shutting_down);
+}
+
 template <typename T>
 inline bool
 write_content_without_length(Stream &strm,
@@ -3692,63 +5118,267 @@ inline bool parse_multipart_boundary(const std::string &content_type,
   return !boundary.empty();
 }
 
-#ifdef CPPHTTPLIB_NO_EXCEPTIONS
+// The characters matched by `\s` in a std::regex.
+inline bool is_regex_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' ||
+         c == '\r';
+}
+
+inline bool is_line_break(char c) { return c == '\r' || c == '\n'; }
+
+inline bool equal_case_ignore(const char *b, const char *e, const char *s) {
+  for (; *s; b++, s++) {
+    if (b == e || ::tolower(static_cast<unsigned char>(*b)) != *s) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses `\d*` at `p`. -1 means no digits; returns false on overflow.
+inline bool parse_range_number(const char *&p, const char *e, ssize_t &val) {
+  val = -1;
+  for (; p < e && '0' <= *p && *p <= '9'; p++) {
+    auto d = *p - '0';
+    if (val == -1) { val = 0; }
+    if (val > ((std::numeric_limits<ssize_t>::max)() - d) / 10) {
+      return false;
+    }
+    val = val * 10 + d;
+  }
+  return true;
+}
+
+// bytes=<first>-<last>[, <first>-<last>]...
 inline bool parse_range_header(const std::string &s, Ranges &ranges) {
+  static const char prefix[] = "bytes=";
+  if (s.compare(0, sizeof(prefix) - 1, prefix) != 0) { return false; }
+
+  auto p = s.data() + sizeof(prefix) - 1;
+  auto e = s.data() + s.size();
+  auto begin = ranges.size();
+  while (true) {
+    ssize_t first, last;
+    if (!parse_range_number(p, e, first) || p == e || *p++ != '-' ||
+        !parse_range_number(p, e, last) ||
+        (first != -1 && last != -1 && first > last)) {
+      ranges.resize(begin);
+      return false;
+    }
+    ranges.emplace_back(first, last);
+    if (p == e) { return true; }
+    if (*p++ != ',') {
+      ranges.resize(begin);
+      return false;
+    }
+    while (p < e && is_regex_space(*p)) {
+      p++;
+    }
+  }
+}
+
+inline bool if_range_matches(const Request &req, const std::string &etag,
+                             const std::string &last_modified) {
+  if (!req.has_header("If-Range")) { return true; }
+  auto val = trim_copy(req.get_header_value("If-Range"));
+
+  // Entity tags need a strong comparison, so a weak tag never matches.
+  if (!val.empty() && (val[0] == '"' || !val.compare(0, 2, "W/"))) {
+    return val == etag;
+  }
+  return val == last_modified;
+}
+
+// Evaluates If-None-Match, or If-Modified-Since when there is none, for a GET
+// or HEAD of a resource with the given validators (RFC 7232 section 6).
+inline bool is_not_modified(const Request &req, const std::string &etag,
+                            time_t mtime) {
+  if (req.has_header("If-None-Match")) { return etag_matches(req, etag); }
+
+#ifndef _WIN32
+  if (req.has_header("If-Modified-Since")) {
+    const auto &val = req.get_header_value("If-Modified-Since");
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    auto end = strptime(val.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0') { return false; }
+    return mtime <= timegm(&tm);
+  }
 #else
-inline bool parse_range_header(const std::string &s, Ranges &ranges) try {
+  (void)mtime;
 #endif
-  static auto re_first_range = std::regex(R"(bytes=(\d*-\d*(?:,\s*\d*-\d*)*))");
-  std::smatch m;
-  if (std::regex_match(s, m, re_first_range)) {
-    auto pos = static_cast<size_t>(m.position(1));
-    auto len = static_cast<size_t>(m.length(1));
-    bool all_valid_ranges = true;
-    split(&s[pos], &s[pos + len], ',', [&](const char *b, const char *e) {
-      if (!all_valid_ranges) return;
-      static auto re_another_range = std::regex(R"(\s*(\d*)-(\d*))");
-      std::cmatch cm;
-      if (std::regex_match(b, e, cm, re_another_range)) {
-        ssize_t first = -1;
-        if (!cm.str(1).empty()) {
-          first = static_cast<ssize_t>(std::stoll(cm.str(1)));
-        }
+  return false;
+}
 
-        ssize_t last = -1;
-        if (!cm.str(2).empty()) {
-          last = static_cast<ssize_t>(std::stoll(cm.str(2)));
-        }
+// Resolves open-ended and suffix ranges against the content length and drops
+// the unsatisfiable ones. Returns false when nothing is left to send.
+inline bool normalize_ranges(Ranges &ranges, size_t content_length) {
+  auto slen = static_cast<ssize_t>(content_length);
+  Ranges satisfiable;
+  for (auto r : ranges) {
+    if (r.first == -1 && r.second == -1) { continue; }
 
-        if (first != -1 && last != -1 && first > last) {
-          all_valid_ranges = false;
-          return;
-        }
-        ranges.emplace_back(std::make_pair(first, last));
-      }
-    });
-    return all_valid_ranges;
+    if (r.first == -1) {
+      if (r.second == 0) { continue; }
+      r.first = (std::max)(static_cast<ssize_t>(0), slen - r.second);
+      r.second = slen - 1;
+    } else {
+      if (r.first >= slen) { continue; }
+      if (r.second == -1 || r.second >= slen) { r.second = slen - 1; }
+    }
+    satisfiable.emplace_back(r);
+  }
+  ranges.swap(satisfiable);
+  return !ranges.empty();
+}
+
+// Content-Disposition: form-data; name="<name>"[; filename="<filename>"]
+// Both values end at the first quote that lets the rest of the line match,
+// and neither may contain a line break.
+inline bool parse_content_disposition(const char *b, const char *e,
+                                      std::string &name,
+                                      std::string &filename) {
+  static const char prefix[] = "content-disposition:";
+  if (!equal_case_ignore(b, e, prefix)) { return false; }
+  auto p = b + sizeof(prefix) - 1;
+  while (p < e && is_regex_space(*p)) {
+    p++;
+  }
+  if (!equal_case_ignore(p, e, "form-data;")) { return false; }
+  p += 10;
+  while (p < e && is_regex_space(*p)) {
+    p++;
+  }
+  if (!equal_case_ignore(p, e, "name=\"")) { return false; }
+  p += 6;
+
+  // The filename, if any, ends at a quote followed only by white space.
+  auto end = e;
+  while (end > p && is_regex_space(end[-1])) {
+    end--;
+  }
+  auto last_quote = end > p && end[-1] == '"' ? end - 1 : nullptr;
+  auto last_break = last_quote;
+  while (last_break && last_break > p && !is_line_break(*--last_break)) {}
+
+  for (auto q = p; q < e && !is_line_break(*q); q++) {
+    if (*q != '"') { continue; }
+    if (q + 1 >= end) {
+      name.assign(p, q);
+      filename.clear();
+      return true;
+    }
+    if (q[1] != ';' || !last_quote) { continue; }
+    auto f = q + 2;
+    while (f < e && is_regex_space(*f)) {
+      f++;
+    }
+    if (!equal_case_ignore(f, e, "filename=\"")) { continue; }
+    f += 10;
+    if (f <= last_quote && (last_break < f || !is_line_break(*last_break))) {
+      name.assign(p, q);
+      filename.assign(f, last_quote);
+      return true;
+    }
   }
   return false;
-#ifdef CPPHTTPLIB_NO_EXCEPTIONS
 }
+
+// Returns the position of the first occurrence of `s` (m bytes) in `b`
+// (n bytes), or n if there is none.
+inline size_t find_bytes_scalar(const char *b, size_t n, const char *s,
+                                size_t m) {
+  if (m == 0) { return 0; }
+  if (m > n) { return n; }
+  auto last = n - m;
+  size_t i = 0;
+  while (i <= last) {
+    auto p = static_cast<const char *>(memchr(b + i, s[0], last - i + 1));
+    if (!p) { return n; }
+    i = static_cast<size_t>(p - b);
+    if (b[i + m - 1] == s[m - 1] && !memcmp(b + i + 1, s + 1, m - 1)) {
+      return i;
+    }
+    i++;
+  }
+  return n;
+}
+
+#ifdef CPPHTTPLIB_X86_SIMD
+// The vector versions compare 16 or 32 candidate positions at once against
+// both the first and the last byte of `s`, and only call memcmp where both
+// match. A multipart delimiter starts with '\r', so binary data rarely gets
+// that far.
+inline size_t find_bytes_sse2(const char *b, size_t n, const char *s,
+                              size_t m) {
+  if (m < 2 || m > n) { return find_bytes_scalar(b, n, s, m); }
+  const auto first = _mm_set1_epi8(s[0]);
+  const auto last = _mm_set1_epi8(s[m - 1]);
+  size_t i = 0;
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    auto bf = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    auto bl =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + m - 1));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last))));
+    while (mask) {
+      auto j = i + static_cast<size_t>(__builtin_ctz(mask));
+      if (!memcmp(b + j + 1, s + 1, m - 2)) { return j; }
+      mask &= mask - 1;
+    }
+  }
+  auto pos = find_bytes_scalar(b + i, n - i, s, m);
+  return pos == n - i ? n : i + pos;
+}
+
+__attribute__((target("avx2"))) inline size_t
+find_bytes_avx2(const char *b, size_t n, const char *s, size_t m) {
+  if (m < 2 || m > n) { return find_bytes_scalar(b, n, s, m); }
+  const auto first = _mm256_set1_epi8(s[0]);
+  const auto last = _mm256_set1_epi8(s[m - 1]);
+  size_t i = 0;
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    auto bf = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    auto bl =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + m - 1));
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last))));
+    while (mask) {
+      auto j = i + static_cast<size_t>(__builtin_ctz(mask));
+      if (!memcmp(b + j + 1, s + 1, m - 2)) { return j; }
+      mask &= mask - 1;
+    }
+  }
+  auto pos = find_bytes_sse2(b + i, n - i, s, m);
+  return pos == n - i ? n : i + pos;
+}
+#endif
+
+inline size_t find_bytes(const char *b, size_t n, const char *s, size_t m) {
+#ifdef CPPHTTPLIB_X86_SIMD
+  // SSE2 is part of x86-64; AVX2 is picked at run time from cpuid.
+  static const auto fn =
+      __builtin_cpu_supports("avx2") ? find_bytes_avx2 : find_bytes_sse2;
+  return fn(b, n, s, m);
 #else
-} catch (...) { return false; }
+  return find_bytes_scalar(b, n, s, m);
 #endif
+}
 
 class MultipartFormDataParser {
 public:
   MultipartFormDataParser() = default;
 
-  void set_boundary(std::string &&boundary) { boundary_ = boundary; }
+  void set_boundary(std::string &&boundary) {
+    boundary_ = boundary;
+    delimiter_ = "\r\n--" + boundary_;
+  }
 
   bool is_valid() const { return is_valid_; }
 
   bool parse(const char *buf, size_t n, const ContentReceiver &content_callback,
              const MultipartContentHeader &header_callback) {
 
-    static const std::regex re_content_disposition(
-        "^Content-Disposition:\\s*form-data;\\s*name=\"(.*?)\"(?:;\\s*filename="
-        "\"(.*?)\")?\\s*$",
-        std::regex_constants::icase);
     static const std::string dash_ = "--";
     static const std::string crlf_ = "\r\n";
 
@@ -3784,16 +5414,13 @@ public:
             break;
           }
 
-          static const std::string header_name = "content-type:";
-          const auto header = buf_head(pos);
-          if (start_with_case_ignore(header, header_name)) {
-            file_.content_type = trim_copy(header.substr(header_name.size()));
+          const auto header = buf_data();
+          if (equal_case_ignore(header, header + pos, "content-type:")) {
+            auto r = trim(header, header + pos, 13, pos);
+            file_.content_type.assign(header + r.first, header + r.second);
           } else {
-            std::smatch m;
-            if (std::regex_match(header, m, re_content_disposition)) {
-              file_.name = m[1];
-              file_.filename = m[2];
-            }
+            parse_content_disposition(header, header + pos, file_.name,
+                                      file_.filename);
           }
 
           buf_erase(pos + crlf_.size());
@@ -3803,42 +5430,28 @@ public:
         break;
       }
       case 3: { // Body
-        {
-          auto pattern = crlf_ + dash_;
-          if (pattern.size() > buf_size()) { return true; }
-
-          auto pos = buf_find(pattern);
-
+        auto pos = buf_find(delimiter_);
+        if (pos < buf_size()) {
           if (!content_callback(buf_data(), pos)) {
             is_valid_ = false;
             return false;
           }
 
-          buf_erase(pos);
+          buf_erase(pos + delimiter_.size());
+          state_ = 4;
+          break;
         }
-        {
-          auto pattern = crlf_ + dash_ + boundary_;
-          if (pattern.size() > buf_size()) { return true; }
-
-          auto pos = buf_find(pattern);
-          if (pos < buf_size()) {
-            if (!content_callback(buf_data(), pos)) {
-              is_valid_ = false;
-              return false;
-            }
-
-            buf_erase(pos + pattern.size());
-            state_ = 4;
-          } else {
-            if (!content_callback(buf_data(), pattern.size())) {
-              is_valid_ = false;
-              return false;
-            }
 
-            buf_erase(pattern.size());
-          }
+        // Everything except a tail that may be the start of the delimiter
+        // belongs to the body.
+        if (buf_size() < delimiter_.size()) { return true; }
+        auto len = buf_size() - (delimiter_.size() - 1);
+        if (!content_callback(buf_data(), len)) {
+          is_valid_ = false;
+          return false;
         }
-        break;
+        buf_erase(len);
+        return true;
       }
       case 4: { // Boundary
         if (crlf_.size() > buf_size()) { return true; }
@@ -3875,16 +5488,8 @@ private:
     file_.content_type.clear();
   }
 
-  bool start_with_case_ignore(const std::string &a,
-                              const std::string &b) const {
-    if (a.size() < b.size()) { return false; }
-    for (size_t i = 0; i < b.size(); i++) {
-      if (::tolower(a[i]) != ::tolower(b[i])) { return false; }
-    }
-    return true;
-  }
-
   std::string boundary_;
+  std::string delimiter_;
 
   size_t state_ = 0;
   bool is_valid_ = false;
@@ -3904,50 +5509,25 @@ private:
 
   const char *buf_data() const { return &buf_[buf_spos_]; }
 
-  std::string buf_head(size_t l) const { return buf_.substr(buf_spos_, l); }
-
   bool buf_start_with(const std::string &s) const {
     return start_with(buf_, buf_spos_, buf_epos_, s);
   }
 
   size_t buf_find(const std::string &s) const {
-    auto c = s.front();
-
-    size_t off = buf_spos_;
-    while (off < buf_epos_) {
-      auto pos = off;
-      while (true) {
-        if (pos == buf_epos_) { return buf_size(); }
-        if (buf_[pos] == c) { break; }
-        pos++;
-      }
-
-      auto remaining_size = buf_epos_ - pos;
-      if (s.size() > remaining_size) { return buf_size(); }
-
-      if (start_with(buf_, pos, buf_epos_, s)) { return pos - buf_spos_; }
-
-      off = pos + 1;
-    }
-
-    return buf_size();
+    return find_bytes(buf_data(), buf_size(), s.data(), s.size());
   }
 
   void buf_append(const char *data, size_t n) {
     auto remaining_size = buf_size();
     if (remaining_size > 0 && buf_spos_ > 0) {
-      for (size_t i = 0; i < remaining_size; i++) {
-        buf_[i] = buf_[buf_spos_ + i];
-      }
+      memmove(&buf_[0], &buf_[buf_spos_], remaining_size);
     }
     buf_spos_ = 0;
     buf_epos_ = remaining_size;
 
     if (remaining_size + n > buf_.size()) { buf_.resize(remaining_size + n); }
 
-    for (size_t i = 0; i < n; i++) {
-      buf_[buf_epos_ + i] = data[i];
-    }
+    if (n > 0) { memcpy(&buf_[buf_epos_], data, n); }
     buf_epos_ += n;
   }
 
@@ -4027,6 +5607,9 @@ bool process_multipart_ranges_data(const Request &req, Response &res,
                                    const std::string &content_type,
                                    SToken stoken, CToken ctoken,
                                    Content content) {
+  auto content_length =
+      res.content_length_ > 0 ? res.content_length_ : res.body.size();
+
   for (size_t i = 0; i < req.ranges.size(); i++) {
     ctoken("--");
     stoken(boundary);
@@ -4037,12 +5620,12 @@ bool process_multipart_ranges_data(const Request &req, Response &res,
       ctoken("\r\n");
     }
 
-    auto offsets = get_range_offset_and_length(req, res.body.size(), i);
+    auto offsets = get_range_offset_and_length(req, content_length, i);
     auto offset = offsets.first;
     auto length = offsets.second;
 
     ctoken("Content-Range: ");
-    stoken(make_content_range_header_field(offset, length, res.body.size()));
+    stoken(make_content_range_header_field(offset, length, content_length));
     ctoken("\r\n");
     ctoken("\r\n");
     if (!content(offset, length)) { return false; }
@@ -4102,8 +5685,8 @@ inline bool write_multipart_ranges_data(Stream &strm, const Request &req,
       [&](const std::string &token) { strm.write(token); },
       [&](const char *token) { strm.write(token); },
       [&](size_t offset, size_t length) {
-        return write_content(strm, res.content_provider_, offset, length,
-                             is_shutting_down);
+        return write_response_content(strm, res, offset, length,
+                                      is_shutting_down);
       });
 }
 
@@ -4275,12 +5858,98 @@ inline std::pair<std::string, std::string> make_digest_authentication_header(
 }
 #endif
 
+// HTTP/1.<0|1> <3 digits>[ <reason>]<CRLF or LF>
+inline bool parse_status_line(const char *s, Response &res) {
+  auto e = s + strlen(s);
+#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
+  if (e - s < 2 || e[-2] != '\r' || e[-1] != '\n') { return false; }
+  e -= 2;
+#else
+  if (e == s || e[-1] != '\n') { return false; }
+  e -= (e - s >= 2 && e[-2] == '\r') ? 2 : 1;
+#endif
+  if (e - s < 12 || strncmp(s, "HTTP/1.", 7) != 0 ||
+      (s[7] != '0' && s[7] != '1') || s[8] != ' ' || !isdigit(s[9] & 0xff) ||
+      !isdigit(s[10] & 0xff) || !isdigit(s[11] & 0xff)) {
+    return false;
+  }
+  auto reason = s + 12;
+  if (reason < e) {
+    if (*reason++ != ' ') { return false; }
+    if (std::find_if(reason, e, is_line_break) != e) { return false; }
+  }
+  res.version.assign(s, 8);
+  res.status = (s[9] - '0') * 100 + (s[10] - '0') * 10 + (s[11] - '0');
+  res.reason.assign(reason, e);
+  return true;
+}
+
+// Collects `key=value` and `key="value"` pairs separated by commas. Keys
+// run up to the first '=' and may not contain a line break; a value that
+// does not start with a closed quote runs up to the next comma.
+inline void parse_auth_params(const std::string &s,
+                              std::map<std::string, std::string> &auth) {
+  auto n = s.size();
+  // Position of the first '=' after a key starting at k, or npos.
+  auto find_eq = [&](size_t k) {
+    if (k >= n || is_line_break(s[k])) { return std::string::npos; }
+    for (auto i = k + 1; i < n && !is_line_break(s[i]); i++) {
+      if (s[i] == '=') { return i; }
+    }
+    return std::string::npos;
+  };
+
+  size_t p = 0;
+  while (p < n) {
+    // A leading ", " is skipped when the key can still be found after it.
+    auto k = p;
+    auto eq = std::string::npos;
+    if (s[p] == ',') {
+      auto q = p + 1;
+      while (q < n && is_regex_space(s[q])) {
+        q++;
+      }
+      for (; q > p && eq == std::string::npos; q--) {
+        eq = find_eq(q);
+        k = q;
+      }
+    }
+    if (eq == std::string::npos) {
+      k = p;
+      eq = find_eq(p);
+    }
+    if (eq == std::string::npos) {
+      p++;
+      continue;
+    }
+
+    auto v = eq + 1;
+    auto end = v;
+    std::string val;
+    if (v < n && s[v] == '"') {
+      end = v + 1;
+      while (end < n && s[end] != '"' && !is_line_break(s[end])) {
+        end++;
+      }
+    }
+    if (v < n && s[v] == '"' && end < n && s[end] == '"') {
+      val.assign(s, v + 1, end - v - 1);
+      end++;
+    } else {
+      end = s.find(',', v);
+      if (end == std::string::npos) { end = n; }
+      val.assign(s, v, end - v);
+    }
+    auth[s.substr(k, eq - k)] = std::move(val);
+    p = end;
+  }
+}
+
 inline bool parse_www_authenticate(const Response &res,
                                    std::map<std::string, std::string> &auth,
                                    bool is_proxy) {
   auto auth_key = is_proxy ? "Proxy-Authenticate" : "WWW-Authenticate";
   if (res.has_header(auth_key)) {
-    static auto re = std::regex(R"~((?:(?:,\s*)?(.+?)=(?:"(.*?)"|([^,]*))))~");
     auto s = res.get_header_value(auth_key);
     auto pos = s.find(' ');
     if (pos != std::string::npos) {
@@ -4289,18 +5958,7 @@ inline bool parse_www_authenticate(const Response &res,
         return false;
       } else if (type == "Digest") {
         s = s.substr(pos + 1);
-        auto beg = std::sregex_iterator(s.begin(), s.end(), re);
-        for (auto i = beg; i != std::sregex_iterator(); ++i) {
-          auto m = *i;
-          auto key = s.substr(static_cast<size_t>(m.position(1)),
-                              static_cast<size_t>(m.length(1)));
-          auto val = m.length(2) > 0
-                         ? s.substr(static_cast<size_t>(m.position(2)),
-                                    static_cast<size_t>(m.length(2)))
-                         : s.substr(static_cast<size_t>(m.position(3)),
-                                    static_cast<size_t>(m.length(3)));
-          auth[key] = val;
-        }
+        parse_auth_params(s, auth);
         return true;
       }
     }
@@ -4338,6 +5996,14 @@ private:
 
 } // namespace detail
 
+inline AllocatorStats allocator_stats() {
+  AllocatorStats stats;
+  stats.requests = detail::object_pool<Request>::counters().snapshot();
+  stats.responses = detail::object_pool<Response>::counters().snapshot();
+  stats.buffers = detail::buffer_pool::instance().stats();
+  return stats;
+}
+
 inline std::string hosted_at(const char *hostname) {
   std::vector<std::string> addrs;
   hosted_at(hostname, addrs);
@@ -4381,6 +6047,25 @@ inline std::string append_query_params(const char *path, const Params &params) {
   return path_with_query;
 }
 
+// Whether If-None-Match lists the etag, using the weak comparison
+// (RFC 7232 section 3.2). False when the request has no If-None-Match.
+inline bool etag_matches(const Request &req, const std::string &etag) {
+  if (!req.has_header("If-None-Match")) { return false; }
+  auto opaque = [](const std::string &tag) {
+    return tag.compare(0, 2, "W/") ? tag : tag.substr(2);
+  };
+  auto matched = false;
+  const auto &val = req.get_header_value("If-None-Match");
+  detail::split(val.data(), val.data() + val.size(), ',',
+                [&](const char *b, const char *e) {
+                  std::string tag(b, e);
+                  if (tag == "*" || opaque(tag) == opaque(etag)) {
+                    matched = true;
+                  }
+                });
+  return matched;
+}
+
 // Header utilities
 inline std::pair<std::string, std::string> make_range_header(Ranges ranges) {
   std::string field = "bytes=";
@@ -4580,8 +6265,280 @@ inline ssize_t Stream::write(const std::string &s) {
   return write(s.data(), s.size());
 }
 
+inline ssize_t Stream::send_file(int /*fd*/, size_t /*offset*/,
+                                 size_t /*size*/) {
+  errno = ENOSYS;
+  return -1;
+}
+
 namespace detail {
 
+#if defined(__linux__) && defined(CPPHTTPLIB_IO_URING_SUPPORT)
+// Minimal io_uring driver built on the raw system calls (no liburing). It
+// moves a file range to a socket through a per-thread pipe with linked
+// splice submissions, CPPHTTPLIB_IO_URING_BATCH pipe-sized chunks per
+// io_uring_enter. Each socket splice carries a linked timeout so a stalled
+// peer can't hold the worker forever. One ring per thread.
+class IoUring {
+public:
+  // Returns the calling thread's ring, or nullptr when the kernel refuses
+  // io_uring (old kernel, seccomp, io_uring_disabled, ...).
+  static IoUring *get() {
+    static std::atomic<bool> unsupported(false);
+    if (unsupported) { return nullptr; }
+
+    static thread_local std::unique_ptr<IoUring> ring;
+    static thread_local bool tried = false;
+    if (!tried) {
+      tried = true;
+      std::unique_ptr<IoUring> r(new IoUring());
+      if (r->init()) {
+        ring = std::move(r);
+      } else {
+        unsupported = true;
+      }
+    }
+    return ring.get();
+  }
+
+  IoUring(const IoUring &) = delete;
+
+  ~IoUring() {
+    close_pipe();
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+    }
+    if (cq_ptr_ != MAP_FAILED) { munmap(cq_ptr_, cq_len_); }
+    if (sq_ptr_ != MAP_FAILED) { munmap(sq_ptr_, sq_len_); }
+    if (ring_fd_ >= 0) { ::close(ring_fd_); }
+  }
+
+  // Same contract as sendfile(2) on a blocking socket: returns the number of
+  // bytes sent, or -1 with errno set. ENOSYS/EINVAL mean "use another way".
+  ssize_t splice_file(socket_t sock, int fd, size_t offset, size_t size,
+                      time_t timeout_sec, time_t timeout_usec) {
+    if (disabled_ || (pipe_[0] < 0 && !open_pipe())) {
+      errno = ENOSYS;
+      return -1;
+    }
+
+    __kernel_timespec ts;
+    ts.tv_sec = timeout_sec;
+    ts.tv_nsec = timeout_usec * 1000;
+    auto with_timeout = timeout_sec > 0 || timeout_usec > 0;
+    unsigned per_chunk = with_timeout ? 3 : 2;
+
+    // file -> pipe, pipe -> socket, link timeout; repeated per chunk
+    unsigned pairs = 0;
+    size_t queued = 0;
+    while (pairs < CPPHTTPLIB_IO_URING_BATCH && queued < size) {
+      auto len = (std::min)(pipe_size_, size - queued);
+      auto last = pairs + 1 == CPPHTTPLIB_IO_URING_BATCH ||
+                  queued + len == size;
+
+      auto in = next_sqe();
+      in->opcode = IORING_OP_SPLICE;
+      in->flags = IOSQE_IO_LINK | (fixed_ ? IOSQE_FIXED_FILE : 0);
+      in->fd = fixed_ ? 1 : pipe_[1];
+      in->splice_fd_in = fd;
+      in->splice_off_in = offset + queued;
+      in->off = static_cast<__u64>(-1);
+      in->len = static_cast<__u32>(len);
+      in->splice_flags = SPLICE_F_MOVE;
+      in->user_data = pairs * 3;
+
+      auto out = next_sqe();
+      out->opcode = IORING_OP_SPLICE;
+      out->flags = (with_timeout || !last) ? IOSQE_IO_LINK : 0;
+      out->fd = sock;
+      out->splice_fd_in = fixed_ ? 0 : pipe_[0];
+      out->splice_off_in = static_cast<__u64>(-1);
+      out->off = static_cast<__u64>(-1);
+      out->len = static_cast<__u32>(len);
+      out->splice_flags = SPLICE_F_MOVE | (fixed_ ? SPLICE_F_FD_IN_FIXED : 0);
+      out->user_data = pairs * 3 + 1;
+
+      if (with_timeout) {
+        auto timeout = next_sqe();
+        timeout->opcode = IORING_OP_LINK_TIMEOUT;
+        timeout->flags = last ? 0 : IOSQE_IO_LINK;
+        timeout->fd = -1;
+        timeout->addr = reinterpret_cast<__u64>(&ts);
+        timeout->len = 1;
+        timeout->user_data = pairs * 3 + 2;
+      }
+
+      queued += len;
+      pairs++;
+    }
+
+    if (!submit_and_wait(pairs * per_chunk)) { return -1; }
+
+    // Tally the completions. A short or failed splice cancels the rest of
+    // the chain, so whatever reached the pipe but not the socket is sent
+    // below before returning.
+    size_t filled = 0;
+    size_t sent = 0;
+    int error = 0;
+    for (unsigned i = 0; i < pairs * per_chunk; i++) {
+      auto &cqe = cqes_[*cq_head_ & *cq_mask_];
+      auto kind = cqe.user_data % 3;
+      auto res = cqe.res;
+      __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+      if (kind == 2) { continue; }
+      if (res < 0) {
+        if (res != -ECANCELED && error == 0) { error = -res; }
+        continue;
+      }
+      if (kind == 0) {
+        filled += static_cast<size_t>(res);
+      } else {
+        sent += static_cast<size_t>(res);
+      }
+    }
+
+    while (filled > sent) {
+      auto n = handle_EINTR([&]() {
+        return ::splice(pipe_[0], nullptr, sock, nullptr, filled - sent,
+                        SPLICE_F_MOVE);
+      });
+      if (n <= 0) {
+        // The pipe still holds data for this response; never reuse it.
+        close_pipe();
+        if (error == 0) { error = n < 0 ? errno : EPIPE; }
+        break;
+      }
+      sent += static_cast<size_t>(n);
+    }
+
+    if (sent == 0 && error != 0) {
+      if (error == EINVAL && filled == 0) {
+        // Splice (or linked timeouts) not supported by this kernel
+        disabled_ = true;
+      }
+      errno = error;
+      return -1;
+    }
+    return static_cast<ssize_t>(sent);
+  }
+
+private:
+  IoUring() = default;
+
+  bool init() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup,
+                                        CPPHTTPLIB_IO_URING_BATCH * 3,
+                                        &params));
+    if (ring_fd_ < 0) { return false; }
+
+    sq_entries_ = params.sq_entries;
+    sq_len_ = params.sq_off.array + params.sq_entries * sizeof(__u32);
+    cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    cq_ptr_ = mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sq_entries_ * sizeof(io_uring_sqe),
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+             IORING_OFF_SQES));
+    if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED ||
+        sqes_ == MAP_FAILED) {
+      return false;
+    }
+
+    auto sq = static_cast<char *>(sq_ptr_);
+    sq_head_ = reinterpret_cast<__u32 *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<__u32 *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<__u32 *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<__u32 *>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<__u32 *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<__u32 *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<__u32 *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  // The pipe is registered as fixed files 0 (read end) and 1 (write end) so
+  // the kernel doesn't look the descriptors up on every splice.
+  bool open_pipe() {
+    if (pipe2(pipe_, O_CLOEXEC) != 0) {
+      pipe_[0] = pipe_[1] = -1;
+      return false;
+    }
+    fcntl(pipe_[1], F_SETPIPE_SZ, CPPHTTPLIB_IO_URING_PIPE_SIZE);
+    auto size = fcntl(pipe_[1], F_GETPIPE_SZ);
+    pipe_size_ = size > 0 ? static_cast<size_t>(size) : 65536;
+    fixed_ = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES,
+                     pipe_, 2) == 0;
+    return true;
+  }
+
+  void close_pipe() {
+    if (pipe_[0] < 0) { return; }
+    if (fixed_) {
+      syscall(__NR_io_uring_register, ring_fd_, IORING_UNREGISTER_FILES,
+              nullptr, 0);
+      fixed_ = false;
+    }
+    ::close(pipe_[0]);
+    ::close(pipe_[1]);
+    pipe_[0] = pipe_[1] = -1;
+  }
+
+  io_uring_sqe *next_sqe() {
+    auto tail = *sq_tail_;
+    auto index = tail & *sq_mask_;
+    auto sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+  }
+
+  // Submits everything queued and waits until `count` completions are ready.
+  bool submit_and_wait(unsigned count) {
+    while (true) {
+      auto pending = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      auto ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+      if (pending == 0 && ready >= count) { return true; }
+      auto ret = syscall(__NR_io_uring_enter, ring_fd_, pending,
+                         count - ready, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret < 0 && errno != EINTR) {
+        // The ring is in an unknown state; stop using it on this thread.
+        disabled_ = true;
+        return false;
+      }
+    }
+  }
+
+  int ring_fd_ = -1;
+  unsigned sq_entries_ = 0;
+  size_t sq_len_ = 0;
+  size_t cq_len_ = 0;
+  void *sq_ptr_ = MAP_FAILED;
+  void *cq_ptr_ = MAP_FAILED;
+  io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  __u32 *sq_head_ = nullptr;
+  __u32 *sq_tail_ = nullptr;
+  __u32 *sq_mask_ = nullptr;
+  __u32 *sq_array_ = nullptr;
+  __u32 *cq_head_ = nullptr;
+  __u32 *cq_tail_ = nullptr;
+  __u32 *cq_mask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+  int pipe_[2] = {-1, -1};
+  size_t pipe_size_ = 0;
+  bool fixed_ = false;
+  bool disabled_ = false;
+};
+#endif
+
 // Socket stream implementation
 inline SocketStream::SocketStream(socket_t sock, time_t read_timeout_sec,
                                   time_t read_timeout_usec,
@@ -4590,12 +6547,28 @@ inline SocketStream::SocketStream(socket_t sock, time_t read_timeout_sec,
     : sock_(sock), read_timeout_sec_(read_timeout_sec),
       read_timeout_usec_(read_timeout_usec),
       write_timeout_sec_(write_timeout_sec),
-      write_timeout_usec_(write_timeout_usec), read_buff_(read_buff_size_, 0) {}
+      write_timeout_usec_(write_timeout_usec) {}
 
-inline SocketStream::~SocketStream() {}
+inline SocketStream::~SocketStream() {
+  if (read_buff_) {
+    buffer_pool::instance().release(read_buff_, read_buff_size_);
+  }
+}
 
 inline bool SocketStream::is_readable() const {
-  return select_read(sock_, read_timeout_sec_, read_timeout_usec_) > 0;
+  return has_buffered_data() ||
+         select_read(sock_, read_timeout_sec_, read_timeout_usec_) > 0;
+}
+
+inline bool SocketStream::has_buffered_data() const {
+  return read_buff_off_ < read_buff_content_size_;
+}
+
+inline void SocketStream::release_read_buffer() {
+  if (read_buff_ && !has_buffered_data()) {
+    buffer_pool::instance().release(read_buff_, read_buff_size_);
+    read_buff_ = nullptr;
+  }
 }
 
 inline bool SocketStream::is_writable() const {
@@ -4614,11 +6587,11 @@ inline ssize_t SocketStream::read(char *ptr, size_t size) {
   if (read_buff_off_ < read_buff_content_size_) {
     auto remaining_size = read_buff_content_size_ - read_buff_off_;
     if (size <= remaining_size) {
-      memcpy(ptr, read_buff_.data() + read_buff_off_, size);
+      memcpy(ptr, read_buff_ + read_buff_off_, size);
       read_buff_off_ += size;
       return static_cast<ssize_t>(size);
     } else {
-      memcpy(ptr, read_buff_.data() + read_buff_off_, remaining_size);
+      memcpy(ptr, read_buff_ + read_buff_off_, remaining_size);
       read_buff_off_ += remaining_size;
       return static_cast<ssize_t>(remaining_size);
     }
@@ -4630,15 +6603,18 @@ inline ssize_t SocketStream::read(char *ptr, size_t size) {
   read_buff_content_size_ = 0;
 
   if (size < read_buff_size_) {
-    auto n = read_socket(sock_, read_buff_.data(), read_buff_size_,
+    if (!read_buff_) {
+      read_buff_ = buffer_pool::instance().acquire(read_buff_size_);
+    }
+    auto n = read_socket(sock_, read_buff_, read_buff_size_,
                          CPPHTTPLIB_RECV_FLAGS);
     if (n <= 0) {
       return n;
     } else if (n <= static_cast<ssize_t>(size)) {
-      memcpy(ptr, read_buff_.data(), static_cast<size_t>(n));
+      memcpy(ptr, read_buff_, static_cast<size_t>(n));
       return n;
     } else {
-      memcpy(ptr, read_buff_.data(), size);
+      memcpy(ptr, read_buff_, size);
       read_buff_off_ = size;
       read_buff_content_size_ = static_cast<size_t>(n);
       return static_cast<ssize_t>(size);
@@ -4666,6 +6642,29 @@ inline void SocketStream::get_remote_ip_and_port(std::string &ip,
 
 inline socket_t SocketStream::socket() const { return sock_; }
 
+inline ssize_t SocketStream::send_file(int fd, size_t offset, size_t size) {
+#ifdef __linux__
+  if (!is_writable()) { return -1; }
+
+  // Linux transfers at most 0x7ffff000 bytes per call.
+  size = (std::min)(size, static_cast<size_t>(0x7ffff000));
+
+#ifdef CPPHTTPLIB_IO_URING_SUPPORT
+  auto ring = IoUring::get();
+  if (ring) {
+    auto n = ring->splice_file(sock_, fd, offset, size, write_timeout_sec_,
+                               write_timeout_usec_);
+    if (n >= 0 || (errno != ENOSYS && errno != EINVAL)) { return n; }
+  }
+#endif
+
+  auto off = static_cast<off_t>(offset);
+  return handle_EINTR([&]() { return ::sendfile(sock_, fd, &off, size); });
+#else
+  return Stream::send_file(fd, offset, size);
+#endif
+}
+
 // Buffer stream implementation
 inline bool BufferStream::is_readable() const { return true; }
 
@@ -4708,66 +6707,56 @@ inline Server::Server()
 inline Server::~Server() {}
 
 inline Server &Server::Get(const std::string &pattern, Handler handler) {
-  get_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  get_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Post(const std::string &pattern, Handler handler) {
-  post_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  post_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Post(const std::string &pattern,
                             HandlerWithContentReader handler) {
-  post_handlers_for_content_reader_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  post_handlers_for_content_reader_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Put(const std::string &pattern, Handler handler) {
-  put_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  put_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Put(const std::string &pattern,
                            HandlerWithContentReader handler) {
-  put_handlers_for_content_reader_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  put_handlers_for_content_reader_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Patch(const std::string &pattern, Handler handler) {
-  patch_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  patch_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Patch(const std::string &pattern,
                              HandlerWithContentReader handler) {
-  patch_handlers_for_content_reader_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  patch_handlers_for_content_reader_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Delete(const std::string &pattern, Handler handler) {
-  delete_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  delete_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Delete(const std::string &pattern,
                               HandlerWithContentReader handler) {
-  delete_handlers_for_content_reader_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  delete_handlers_for_content_reader_.add(pattern, std::move(handler));
   return *this;
 }
 
 inline Server &Server::Options(const std::string &pattern, Handler handler) {
-  options_handlers_.push_back(
-      std::make_pair(std::regex(pattern), std::move(handler)));
+  options_handlers_.add(pattern, std::move(handler));
   return *this;
 }
 
@@ -4805,11 +6794,22 @@ Server::set_file_extension_and_mimetype_mapping(const char *ext,
   return *this;
 }
 
+inline Server &Server::set_file_extension_and_cache_control_mapping(
+    const char *ext, const std::string &cache_control) {
+  file_extension_and_cache_control_map_[ext] = cache_control;
+  return *this;
+}
+
 inline Server &Server::set_file_request_handler(Handler handler) {
   file_request_handler_ = std::move(handler);
   return *this;
 }
 
+inline Server &Server::set_dot_files_hidden(bool on) {
+  dot_files_hidden_ = on;
+  return *this;
+}
+
 inline Server &Server::set_error_handler(HandlerWithResponse handler) {
   error_handler_ = std::move(handler);
   return *this;
@@ -4903,6 +6903,25 @@ inline Server &Server::set_payload_max_length(size_t length) {
   return *this;
 }
 
+inline Server &Server::set_event_loop(size_t io_thread_count) {
+  event_loop_thread_count_ = io_thread_count;
+  return *this;
+}
+
+inline Server &Server::set_file_cache(size_t max_entries,
+                                      size_t max_file_size,
+                                      size_t max_memory) {
+  file_cache_max_entries_ = max_entries;
+  file_cache_max_file_size_ = max_file_size;
+  file_cache_max_memory_ = max_memory;
+  return *this;
+}
+
+inline Server &Server::add_file_cache_exclusion(const std::string &dir) {
+  file_cache_exclusions_.push_back(dir);
+  return *this;
+}
+
 inline bool Server::bind_to_port(const char *host, int port, int socket_flags) {
   if (bind_internal(host, port, socket_flags) < 0) return false;
   return true;
@@ -5024,8 +7043,11 @@ inline bool Server::write_response_core(Stream &strm, bool close_connection,
     res.set_header("Content-Type", "text/plain");
   }
 
+  // A 304 must not claim a length other than the one a 200 would have had,
+  // and a 204 has no body at all.
   if (!res.has_header("Content-Length") && res.body.empty() &&
-      !res.content_length_ && !res.content_provider_) {
+      !res.content_length_ && !res.content_provider_ && res.status != 304 &&
+      res.status != 204) {
     res.set_header("Content-Length", "0");
   }
 
@@ -5082,15 +7104,15 @@ Server::write_content_with_provider(Stream &strm, const Request &req,
 
   if (res.content_length_ > 0) {
     if (req.ranges.empty()) {
-      return detail::write_content(strm, res.content_provider_, 0,
-                                   res.content_length_, is_shutting_down);
+      return detail::write_response_content(strm, res, 0, res.content_length_,
+                                            is_shutting_down);
     } else if (req.ranges.size() == 1) {
       auto offsets =
           detail::get_range_offset_and_length(req, res.content_length_, 0);
       auto offset = offsets.first;
       auto length = offsets.second;
-      return detail::write_content(strm, res.content_provider_, offset, length,
-                                   is_shutting_down);
+      return detail::write_response_content(strm, res, offset, length,
+                                            is_shutting_down);
     } else {
       return detail::write_multipart_ranges_data(
           strm, req, res, boundary, content_type, is_shutting_down);
@@ -5220,25 +7242,137 @@ inline bool Server::read_content_core(Stream &strm, Request &req, Response &res,
   return true;
 }
 
-inline bool Server::handle_file_request(const Request &req, Response &res,
+inline bool Server::handle_file_request(Request &req, Response &res,
                                         bool head) {
   for (const auto &entry : base_dirs_) {
     // Prefix match
     if (!req.path.compare(0, entry.mount_point.size(), entry.mount_point)) {
       std::string sub_path = "/" + req.path.substr(entry.mount_point.size());
+      if (dot_files_hidden_ && sub_path.find("/.") != std::string::npos) {
+        return false;
+      }
       if (detail::is_valid_path(sub_path)) {
         auto path = entry.base_dir + sub_path;
         if (path.back() == '/') { path += "index.html"; }
+        auto type =
+            detail::find_content_type(path, file_extension_and_mimetype_map_);
+
+        // Mount point headers, with a per-extension Cache-Control taking
+        // precedence over the mount point's.
+        auto set_entry_headers = [&]() {
+          auto cache_control = file_extension_and_cache_control_map_.find(
+              detail::file_extension(path));
+          if (cache_control != file_extension_and_cache_control_map_.end()) {
+            res.set_header("Cache-Control", cache_control->second);
+          }
+          for (const auto &kv : entry.headers) {
+            if (cache_control != file_extension_and_cache_control_map_.end() &&
+                !strcasecmp(kv.first.c_str(), "Cache-Control")) {
+              continue;
+            }
+            res.set_header(kv.first.c_str(), kv.second);
+          }
+        };
 
+#ifdef _WIN32
         if (detail::is_file(path)) {
           detail::read_file(path, res.body);
-          auto type =
-              detail::find_content_type(path, file_extension_and_mimetype_map_);
-          if (type) { res.set_header("Content-Type", type); }
-          for (const auto &kv : entry.headers) {
-            res.set_header(kv.first.c_str(), kv.second);
+#else
+        std::shared_ptr<detail::OpenFile> file;
+#ifdef __linux__
+        // Only canonical paths are cached; see FileCache::open().
+        if (file_cache_ && sub_path.find("//") == std::string::npos &&
+            sub_path.find("/.") == std::string::npos) {
+          file = file_cache_->open(
+              path, type && detail::can_compress_content_type(type));
+        } else
+#endif
+        {
+          file = detail::open_file(path);
+        }
+        if (file) {
+          auto size = static_cast<size_t>(file->st.st_size);
+          auto etag = file->etag;
+          const auto &last_modified = file->last_modified;
+
+          // A stale If-Range validator turns the request into a full GET.
+          if (!req.ranges.empty() &&
+              !detail::if_range_matches(req, etag, last_modified)) {
+            req.ranges.clear();
+          }
+
+          // Files held in memory may come with pre-compressed variants. Each
+          // variant gets its own ETag; ranges always refer to the original.
+          auto body = file->body;
+          const char *encoding = nullptr;
+          if (body && req.ranges.empty()) {
+            const auto &accept = req.get_header_value("Accept-Encoding");
+            if (file->brotli && detail::accepts_encoding(accept, "br")) {
+              body = file->brotli;
+              encoding = "br";
+            } else if (file->gzip && detail::accepts_encoding(accept, "gzip")) {
+              body = file->gzip;
+              encoding = "gzip";
+            }
+            if (encoding) {
+              etag.insert(etag.size() - 1, std::string("-") + encoding);
+            }
+          }
+          if (file->gzip || file->brotli) {
+            res.set_header("Vary", "Accept-Encoding");
+          }
+
+          res.set_header("Accept-Ranges", "bytes");
+          res.set_header("ETag", etag);
+          res.set_header("Last-Modified", last_modified);
+          set_entry_headers();
+
+          // The client's copy is still current: answer with the validators
+          // and caching headers only.
+          if (detail::is_not_modified(req, etag, file->st.st_mtime)) {
+            req.ranges.clear();
+            res.status = 304;
+            return true;
           }
-          res.status = req.has_header("Range") ? 206 : 200;
+
+          if (!req.ranges.empty() &&
+              !detail::normalize_ranges(req.ranges, size)) {
+            req.ranges.clear();
+            res.set_header("Content-Range", "bytes */" + std::to_string(size));
+            res.status = 416;
+            return true;
+          }
+
+          if (encoding) { res.set_header("Content-Encoding", encoding); }
+
+          if (body) {
+            if (!body->empty()) {
+              res.content_length_ = body->size();
+              res.content_provider_ = [body](size_t offset, size_t length,
+                                             DataSink &sink) {
+                return sink.write(body->data() + offset, length);
+              };
+              res.is_chunked_content_provider_ = false;
+            }
+          } else if (size > 0) {
+            // Stream the file straight from the page cache instead of copying
+            // it into `res.body`; only the requested ranges are ever read,
+            // and the descriptor lives as long as the response.
+            res.content_length_ = size;
+            res.content_provider_ = detail::make_file_content_provider(file->fd);
+            // The releaser holds the descriptor open until the response is
+            // gone, even if the cache drops the entry meanwhile.
+            res.content_provider_resource_releaser_ = [file](bool /*success*/) {
+            };
+            res.is_chunked_content_provider_ = false;
+            res.content_file_fd_ = file->fd;
+          }
+#endif
+#ifdef _WIN32
+          set_entry_headers();
+#endif
+          if (type) { res.set_header("Content-Type", type); }
+          res.status = req.ranges.empty() ? 200 : 206;
           if (!head && file_request_handler_) {
             file_request_handler_(req, res);
           }
@@ -5297,6 +7431,35 @@ inline bool Server::listen_internal() {
   {
     std::unique_ptr<TaskQueue> task_queue(new_task_queue());
 
+#ifdef __linux__
+    std::unique_ptr<detail::EventLoop> event_loop;
+    if (event_loop_thread_count_ > 0 && supports_event_loop()) {
+      event_loop.reset(new detail::EventLoop(
+          event_loop_thread_count_, *task_queue, keep_alive_max_count_,
+          keep_alive_timeout_sec_, read_timeout_sec_, read_timeout_usec_,
+          write_timeout_sec_, write_timeout_usec_,
+          [this](Stream &strm, bool close_connection,
+                 bool &connection_closed) {
+            return process_request(strm, close_connection, connection_closed,
+                                   nullptr);
+          }));
+      if (!event_loop->start()) { event_loop.reset(); }
+    }
+
+    if (file_cache_max_entries_ > 0 && !base_dirs_.empty()) {
+      std::vector<std::string> dirs;
+      for (const auto &entry : base_dirs_) {
+        dirs.push_back(entry.base_dir);
+      }
+      file_cache_ = std::make_shared<detail::FileCache>(
+          file_cache_max_entries_, file_cache_max_file_size_,
+          file_cache_max_memory_);
+      if (!file_cache_->start(dirs, file_cache_exclusions_)) {
+        file_cache_.reset();
+      }
+    }
+#endif
+
     while (svr_sock_ != INVALID_SOCKET) {
 #ifndef _WIN32
       if (idle_interval_sec_ > 0 || idle_interval_usec_ > 0) {
@@ -5356,6 +7519,13 @@ inline bool Server::listen_internal() {
 #endif
       }
 
+#ifdef __linux__
+      if (event_loop) {
+        event_loop->add(sock);
+        continue;
+      }
+#endif
+
 #if __cplusplus > 201703L
       task_queue->enqueue([=, this]() { process_and_close_socket(sock); });
 #else
@@ -5363,7 +7533,16 @@ inline bool Server::listen_internal() {
 #endif
     }
 
+#ifdef __linux__
+    if (event_loop) { event_loop->stop(); }
+#endif
+
     task_queue->shutdown();
+
+#ifdef __linux__
+    if (event_loop) { event_loop->close_all(); }
+    file_cache_.reset();
+#endif
   }
 
   is_running_ = false;
@@ -5449,16 +7628,10 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
 
 inline bool Server::dispatch_request(Request &req, Response &res,
                                      const Handlers &handlers) {
-  for (const auto &x : handlers) {
-    const auto &pattern = x.first;
-    const auto &handler = x.second;
-
-    if (std::regex_match(req.path, req.matches, pattern)) {
-      handler(req, res);
-      return true;
-    }
-  }
-  return false;
+  auto handler = handlers.match(req);
+  if (!handler) { return false; }
+  (*handler)(req, res);
+  return true;
 }
 
 inline void Server::apply_ranges(const Request &req, Response &res,
@@ -5574,16 +7747,10 @@ inline void Server::apply_ranges(const Request &req, Response &res,
 inline bool Server::dispatch_request_for_content_reader(
     Request &req, Response &res, ContentReader content_reader,
     const HandlersForContentReader &handlers) {
-  for (const auto &x : handlers) {
-    const auto &pattern = x.first;
-    const auto &handler = x.second;
-
-    if (std::regex_match(req.path, req.matches, pattern)) {
-      handler(req, res, content_reader);
-      return true;
-    }
-  }
-  return false;
+  auto handler = handlers.match(req);
+  if (!handler) { return false; }
+  (*handler)(req, res, content_reader);
+  return true;
 }
 
 inline bool
@@ -5597,8 +7764,10 @@ Server::process_request(Stream &strm, bool close_connection,
   // Connection has been closed on client
   if (!line_reader.getline()) { return false; }
 
-  Request req;
-  Response res;
+  auto req_ptr = detail::object_pool<Request>::acquire();
+  auto res_ptr = detail::object_pool<Response>::acquire();
+  auto &req = *req_ptr;
+  auto &res = *res_ptr;
 
   res.version = "HTTP/1.1";
 
@@ -5707,6 +7876,8 @@ Server::process_request(Stream &strm, bool close_connection,
 
 inline bool Server::is_valid() const { return true; }
 
+inline bool Server::supports_event_loop() const { return true; }
+
 inline bool Server::process_and_close_socket(socket_t sock) {
   auto ret = detail::process_server_socket(
       svr_sock_, sock, keep_alive_max_count_, keep_alive_timeout_sec_,
@@ -5857,29 +8028,16 @@ inline bool ClientImpl::read_response_line(Stream &strm, const Request &req,
 
   if (!line_reader.getline()) { return false; }
 
-#ifdef CPPHTTPLIB_ALLOW_LF_AS_LINE_TERMINATOR
-  const static std::regex re("(HTTP/1\\.[01]) (\\d{3})(?: (.*?))?\r\n");
-#else
-  const static std::regex re("(HTTP/1\\.[01]) (\\d{3})(?: (.*?))?\r?\n");
-#endif
-
-  std::cmatch m;
-  if (!std::regex_match(line_reader.ptr(), m, re)) {
+  if (!detail::parse_status_line(line_reader.ptr(), res)) {
     return req.method == "CONNECT";
   }
-  res.version = std::string(m[1]);
-  res.status = std::stoi(std::string(m[2]));
-  res.reason = std::string(m[3]);
 
   // Ignore '100 Continue'
   while (res.status == 100) {
     if (!line_reader.getline()) { return false; } // CRLF
     if (!line_reader.getline()) { return false; } // next response line
 
-    if (!std::regex_match(line_reader.ptr(), m, re)) { return false; }
-    res.version = std::string(m[1]);
-    res.status = std::stoi(std::string(m[2]));
-    res.reason = std::string(m[3]);
+    if (!detail::parse_status_line(line_reader.ptr(), res)) { return false; }
   }
 
   return true;
@@ -7086,7 +9244,8 @@ inline bool process_server_socket_ssl(
         SSLSocketStream strm(sock, ssl, read_timeout_sec, read_timeout_usec,
                              write_timeout_sec, write_timeout_usec);
         return callback(strm, close_connection, connection_closed);
-      });
+      },
+      []() { return false; });
 }
 
 template <typename T>
@@ -7316,6 +9475,10 @@ inline bool SSLServer::is_valid() const { return ctx_; }
 
 inline SSL_CTX *SSLServer::ssl_context() const { return ctx_; }
 
+// The event loop hands raw sockets between threads per request, which does
+// not fit the per-connection TLS session.
+inline bool SSLServer::supports_event_loop() const { return false; }
+
 inline bool SSLServer::process_and_close_socket(socket_t sock) {
   auto ssl = detail::ssl_new(
       sock, ctx_, ctx_mutex_,